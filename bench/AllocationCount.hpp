@@ -0,0 +1,22 @@
+//=============================================================================
+//File Name: AllocationCount.hpp
+//Description: Counts the process's heap allocations for the benchmarks and
+//             tests
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * Linking AllocationCount.cpp into an executable replaces malloc() and its
+ * relatives (or only operator new without glibc) with versions that count
+ * each call.
+ */
+
+#ifndef ALLOCATION_COUNT_HPP
+#define ALLOCATION_COUNT_HPP
+
+#include <cstdint>
+
+// Returns the number of heap allocations the process has made so far
+uint64_t allocationCount();
+
+#endif // ALLOCATION_COUNT_HPP
@@ -0,0 +1,108 @@
+//=============================================================================
+//File Name: Bench.cpp
+//Description: Runs the image processing benchmarks on synthetic frames at
+//             several resolutions
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * Usage: KinectBoardBench [filter]
+ * Only kernels whose names contain filter are run.
+ */
+
+#include <cstring>
+#include <random>
+
+#include <opencv2/imgproc/imgproc_c.h>
+
+#include "Bench.hpp"
+
+static const char* gFilter = nullptr;
+
+bool benchSelected(const char* name) {
+    return gFilter == nullptr || std::strstr(name, gFilter) != nullptr;
+}
+
+Quad benchQuad(CvSize size) {
+    Quad quad;
+
+    // A slightly skewed screen, as seen from a Kinect off to one side
+    quad.point[0] = cvPoint(size.width * 20 / 100, size.height * 20 / 100);
+    quad.point[1] = cvPoint(size.width * 80 / 100, size.height * 22 / 100);
+    quad.point[2] = cvPoint(size.width * 78 / 100, size.height * 80 / 100);
+    quad.point[3] = cvPoint(size.width * 22 / 100, size.height * 78 / 100);
+    quad.validQuad = true;
+
+    return quad;
+}
+
+IplImage* benchScene(CvSize size, int channel, bool pointer, uint32_t seed) {
+    IplImage* image = cvCreateImage(size, IPL_DEPTH_8U, 3);
+
+    std::mt19937 rng(seed);
+    for (int i = 0; i < image->imageSize; i++) {
+        image->imageData[i] = static_cast<char>(rng() & 0x3f);
+    }
+
+    // Frames are in the Kinect's R, G, B order
+    CvScalar color = cvScalar(0, 0, 0);
+    if (channel == FLT_RED) {
+        color = cvScalar(230, 20, 30);
+    }
+    else if (channel == FLT_GREEN) {
+        color = cvScalar(20, 220, 40);
+    }
+    else if (channel == FLT_BLUE) {
+        color = cvScalar(30, 40, 220);
+    }
+
+    Quad quad = benchQuad(size);
+    if (channel == FLT_RED || channel == FLT_GREEN || channel == FLT_BLUE) {
+        cvFillConvexPoly(image, quad.point, 4, color, 8, 0);
+    }
+
+    if (pointer) {
+        CvPoint center = cvPoint(size.width * 45 / 100, size.height * 55 / 100);
+        int radius = size.width / 80 > 4 ? size.width / 80 : 4;
+        cvCircle(image, center, radius, cvScalar(230, 20, 30), -1, 8, 0);
+    }
+
+    return image;
+}
+
+void benchDepthFrame(uint16_t* depth, CvSize size, uint32_t seed) {
+    std::mt19937 rng(seed);
+
+    for (int y = 0; y < size.height; y++) {
+        for (int x = 0; x < size.width; x++) {
+            unsigned int index = y * size.width + x;
+
+            if (index % 97 == 0) {
+                // No reading
+                depth[index] = 2047;
+            }
+            else {
+                depth[index] = 500 + y * 500 / size.height + (rng() & 0xf);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const CvSize sizes[] = {{320, 240}, {640, 480}, {1280, 1024}};
+
+    if (argc > 1) {
+        gFilter = argv[1];
+    }
+
+    std::printf("kernel,width,height,ns_per_frame,mb_per_s,allocs_per_call\n");
+
+    for (auto size : sizes) {
+        colorMaskBench(size);
+        parseBench(size);
+        depthBench(size);
+        trackerBench(size);
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+//=============================================================================
+//File Name: Bench.hpp
+//Description: Timing, allocation counting and synthetic frames shared by the
+//             benchmarks
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * Every benchmark prints one comma-separated line per kernel and resolution:
+ *   kernel,width,height,ns_per_frame,mb_per_s,allocs_per_call
+ * where MB/s counts the bytes of input consumed per call (0 if the kernel
+ * doesn't consume image data) and allocs_per_call counts heap allocations.
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include <opencv2/core/core_c.h>
+
+#include "AllocationCount.hpp"
+#include "../src/CKinect/Parse.hpp"
+
+/* Returns true if the named kernel should run. Kernels can be filtered with a
+ * substring given on the command line.
+ */
+bool benchSelected(const char* name);
+
+/* Creates a frame of dark noise. If channel is FLT_RED, FLT_GREEN or FLT_BLUE,
+ * the screen quadrilateral from benchQuad() is filled with that color, like a
+ * calibration image (pass 0 to leave it out). If pointer is true, a small
+ * red spot is drawn inside the screen.
+ */
+IplImage* benchScene(CvSize size, int channel, bool pointer, uint32_t seed);
+
+// Returns the corners of the screen drawn by benchScene()
+Quad benchQuad(CvSize size);
+
+// Fills depth with a raw 11-bit depth ramp with noise and invalid readings
+void benchDepthFrame(uint16_t* depth, CvSize size, uint32_t seed);
+
+void colorMaskBench(CvSize size);
+void parseBench(CvSize size);
+void depthBench(CvSize size);
+void trackerBench(CvSize size);
+
+template <class Func>
+void benchRun(const char* name, CvSize size, uint64_t bytes, Func func,
+              int iterations = 200) {
+    using namespace std::chrono;
+
+    if (!benchSelected(name)) {
+        return;
+    }
+
+    // Warm up caches, lazily built tables and the kernel dispatchers
+    for (int i = 0; i < 5; i++) {
+        func();
+    }
+
+    uint64_t allocations = allocationCount();
+    auto start = steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        func();
+    }
+    double ns = duration_cast<nanoseconds>(steady_clock::now() - start)
+                .count() / static_cast<double>(iterations);
+    allocations = allocationCount() - allocations;
+
+    std::printf("%s,%d,%d,%.0f,%.1f,%.2f\n", name, size.width, size.height,
+                ns, bytes / ns * 1e9 / (1 << 20),
+                allocations / static_cast<double>(iterations));
+}
+
+#endif // BENCH_HPP
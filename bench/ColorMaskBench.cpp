@@ -0,0 +1,50 @@
+//=============================================================================
+//File Name: ColorMaskBench.cpp
+//Description: Compares the fused RGB to color mask kernel against the OpenCV
+//             HSV pipeline imageFilter used before it
+//Author: Tyler Veness
+//=============================================================================
+
+#include <vector>
+
+#include <opencv2/imgproc/imgproc_c.h>
+
+#include "Bench.hpp"
+#include "../src/CKinect/ColorMask.hpp"
+
+// The red filter imageFilter ran before the fused kernel replaced it
+static void hsvFilter(IplImage* image, IplImage* hsv, IplImage* tmp0,
+                      IplImage* tmp1) {
+    cvCvtColor(image, hsv, CV_RGB2HSV);
+    cvInRangeS(hsv, cvScalar(0, 128, 128, 255), cvScalar(10, 255, 255, 255),
+               tmp1);
+    cvInRangeS(hsv, cvScalar(150, 128, 128, 255),
+               cvScalar(180, 255, 255, 255), tmp0);
+    cvOr(tmp0, tmp1, tmp0, nullptr);
+}
+
+void colorMaskBench(CvSize size) {
+    IplImage* image = benchScene(size, 0, true, 1);
+    IplImage* hsv = cvCreateImage(size, IPL_DEPTH_8U, 3);
+    IplImage* tmp0 = cvCreateImage(size, IPL_DEPTH_8U, 1);
+    IplImage* tmp1 = cvCreateImage(size, IPL_DEPTH_8U, 1);
+    std::vector<uint8_t> mask(size.width * size.height);
+
+    auto rgb = reinterpret_cast<uint8_t*>(image->imageData);
+    unsigned int pixels = size.width * size.height;
+
+    benchRun("hsv_opencv", size, pixels * 3, [&] {
+        hsvFilter(image, hsv, tmp0, tmp1);
+    });
+    benchRun("colormask_scalar", size, pixels * 3, [&] {
+        colorMaskScalar(rgb, &mask[0], pixels, FLT_RED);
+    });
+    benchRun("colormask", size, pixels * 3, [&] {
+        colorMask(rgb, &mask[0], pixels, FLT_RED);
+    });
+
+    cvReleaseImage(&image);
+    cvReleaseImage(&hsv);
+    cvReleaseImage(&tmp0);
+    cvReleaseImage(&tmp1);
+}
@@ -0,0 +1,40 @@
+//=============================================================================
+//File Name: DepthBench.cpp
+//Description: Benchmarks the depth image colorization newDepthFrame does on
+//             every frame
+//Author: Tyler Veness
+//=============================================================================
+
+#include <vector>
+
+#include "Bench.hpp"
+#include "../src/DepthColorizer.hpp"
+#include "../src/CKinect/TouchDetector.hpp"
+
+void depthBench(CvSize size) {
+    unsigned int pixels = size.width * size.height;
+
+    std::vector<uint16_t> depth(pixels);
+    std::vector<uint32_t> bgra(pixels);
+    benchDepthFrame(&depth[0], size, 5);
+
+    DepthColorizer colorizer;
+
+    benchRun("depthColorize", size, pixels * 2, [&] {
+        colorizer.colorize(&depth[0], &bgra[0], pixels);
+    });
+
+    // Touch detection over the screen, after the surface has been learned
+    Quad quad = benchQuad(size);
+    sortquad(quad);
+    QuadSpans spans;
+    spans.build(quad, size);
+
+    TouchDetector touch(size.width, size.height);
+    std::vector<uint8_t> mask(pixels);
+    touch.process(&depth[0], spans, &mask[0], size.width);
+
+    benchRun("touchDetect", size, pixels * 2, [&] {
+        touch.process(&depth[0], spans, &mask[0], size.width);
+    });
+}
@@ -0,0 +1,241 @@
+//=============================================================================
+//File Name: ParseBench.cpp
+//Description: Benchmarks the screen and pointer detection functions in
+//             Parse.cpp
+//Author: Tyler Veness
+//=============================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <list>
+#include <vector>
+
+#include "Bench.hpp"
+#include "../src/CKinect/PointerTracker.hpp"
+#include "../src/CKinect/ColorBackground.hpp"
+
+/* Compares where coarse-to-fine detection puts pointers of a few sizes with
+ * where full-resolution detection puts them. Printed to stderr so the timings
+ * on stdout stay one table.
+ */
+static void pyramidAccuracy(CvSize size, const QuadSpans& spans,
+                            FilterWorkspace& workspace) {
+    if (!benchSelected("findImageLocation_pyramid")) {
+        return;
+    }
+
+    IplImage* background = benchScene(size, 0, false, 5);
+    IplImage* frame = cvCloneImage(background);
+
+    std::vector<CvPoint> full;
+    std::vector<CvPoint> coarse;
+
+    for (int step = 2; step <= 4; step *= 2) {
+        int pointers = 0;
+        int missed = 0;
+        double maxError = 0.0;
+
+        for (int radius = size.width / 160; radius <= size.width / 40;
+                radius += size.width / 160) {
+            for (int i = 0; i < 16; i++) {
+                CvPoint center = cvPoint(
+                    size.width * (30 + 3 * i) / 100 + i % 3,
+                    size.height * (30 + 2 * i) / 100 + i % 4);
+
+                cvCopy(background, frame, nullptr);
+                cvCircle(frame, center, radius, cvScalar(230, 20, 30), -1, 8,
+                         0);
+
+                findImageLocation(frame, FLT_RED, workspace, full);
+                findImageLocationPyramid(frame, FLT_RED, step, spans,
+                                         workspace, coarse);
+
+                for (const auto& point : full) {
+                    if (!spans.contains(point)) {
+                        continue;
+                    }
+                    pointers++;
+
+                    double error = HUGE_VAL;
+                    for (const auto& found : coarse) {
+                        error = std::min(error, std::hypot(
+                            static_cast<double>(found.x - point.x),
+                            static_cast<double>(found.y - point.y)));
+                    }
+
+                    if (error > radius) {
+                        missed++;
+                    }
+                    else {
+                        maxError = std::max(maxError, error);
+                    }
+                }
+            }
+        }
+
+        std::fprintf(stderr, "findImageLocation_pyramid%d,%d,%d: %d of %d "
+                     "pointers found, max error %.2f px\n", step, size.width,
+                     size.height, pointers - missed, pointers, maxError);
+    }
+
+    cvReleaseImage(&frame);
+    cvReleaseImage(&background);
+}
+
+void parseBench(CvSize size) {
+    unsigned int pixels = size.width * size.height;
+
+    IplImage* frame = benchScene(size, 0, true, 2);
+    IplImage* redCalib = benchScene(size, FLT_RED, false, 3);
+    IplImage* blueCalib = benchScene(size, FLT_BLUE, false, 4);
+    IplImage* mask = cvCreateImage(size, IPL_DEPTH_8U, 1);
+
+    FilterWorkspace workspace;
+    workspace.resize(size);
+
+    std::vector<CvPoint> plistRaw;
+    std::vector<CvPoint> plistProc;
+    plistRaw.reserve(64);
+    plistProc.reserve(64);
+
+    Quad quad = benchQuad(size);
+    sortquad(quad);
+
+    QuadSpans spans;
+    spans.build(quad, size);
+
+    Homography homography;
+    homography.build(quad.point);
+
+    ScreenMap screenMap;
+    screenMap.build(quad.point, LensModel::kinectRGB(), size);
+
+    benchRun("imageFilter", size, pixels * 3, [&] {
+        imageFilter(frame, mask, FLT_RED);
+    });
+    benchRun("imageFilter_spans", size, pixels * 3, [&] {
+        imageFilter(frame, mask, FLT_RED, spans);
+    });
+    benchRun("imageFilter_alloc", size, pixels * 3, [&] {
+        IplImage* product;
+        imageFilter(frame, &product, FLT_RED);
+        cvReleaseImage(&product);
+    });
+
+    benchRun("findImageLocation", size, pixels * 3, [&] {
+        findImageLocation(frame, FLT_RED, workspace, plistRaw);
+    });
+    // The contour tracing findMaskLocation() used before blob labeling
+    benchRun("findImageLocation_contours", size, pixels * 3, [&] {
+        imageFilter(frame, workspace.mask, FLT_RED);
+        findMaskContours(workspace.mask, workspace, plistRaw);
+    });
+    benchRun("findMaskBlobs", size, pixels, [&] {
+        findMaskBlobs(mask, workspace, workspace.blobs);
+    });
+    benchRun("findImageLocation_spans", size, pixels * 3, [&] {
+        imageFilter(frame, workspace.mask, FLT_RED, spans);
+        findMaskLocation(workspace.mask, workspace, plistRaw, &spans);
+    });
+    // Steady-state tracking: only the window around the pointer is searched
+    PointerTracker tracker;
+    tracker.update(cvPoint(size.width * 45 / 100, size.height * 55 / 100), 0);
+    QuadSpans window;
+    benchRun("findImageLocation_tracked", size, pixels * 3, [&] {
+        spans.clip(tracker.predict(0, size), window);
+        imageFilter(frame, workspace.mask, FLT_RED, window);
+        findMaskLocation(workspace.mask, workspace, plistRaw, &window);
+    });
+    // One frame of learning and suppressing the static parts of the mask
+    ColorBackground background;
+    background.resize(size);
+    imageFilter(frame, mask, FLT_RED, spans);
+    benchRun("colorBackground", size, pixels * 3, [&] {
+        background.apply(mask, spans);
+    });
+    // Candidates found at a quarter and a sixteenth of the samples
+    benchRun("findImageLocation_pyramid2", size, pixels * 3, [&] {
+        findImageLocationPyramid(frame, FLT_RED, 2, spans, workspace,
+                                 plistRaw);
+    });
+    benchRun("findImageLocation_pyramid4", size, pixels * 3, [&] {
+        findImageLocationPyramid(frame, FLT_RED, 4, spans, workspace,
+                                 plistRaw);
+    });
+    benchRun("findImageLocation_list", size, pixels * 3, [&] {
+        std::list<CvPoint> points = findImageLocation(frame, FLT_RED);
+    });
+
+    // Calibration is slow and writes debug images, so run it fewer times
+    benchRun("findScreenBox", size, pixels * 3 * 2, [&] {
+        findScreenBox(redCalib, nullptr, blueCalib);
+    }, 10);
+
+    // Candidates spread over the whole frame, about half inside the screen
+    std::vector<CvPoint> candidates;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            candidates.push_back(cvPoint(size.width * (2 * x + 1) / 16,
+                                         size.height * (2 * y + 1) / 16));
+        }
+    }
+
+    benchRun("findScreenLocation", size, 0, [&] {
+        findScreenLocation(candidates, quad, 1920, 1080, plistProc);
+    });
+    benchRun("findScreenLocation_homography", size, 0, [&] {
+        findScreenLocation(candidates, homography, spans, 1920, 1080,
+                           plistProc);
+    });
+    benchRun("homographyBuild", size, 0, [&] {
+        homography.build(quad.point);
+    });
+    benchRun("findScreenLocation_screenMap", size, 0, [&] {
+        findScreenLocation(candidates, screenMap, 1920, 1080, plistProc);
+    });
+    benchRun("screenMapBuild", size, 0, [&] {
+        screenMap.build(quad.point, LensModel::kinectRGB(), size);
+    }, 10);
+
+    // Tests every pixel of the frame against the screen
+    volatile int inside = 0;
+    benchRun("quadCheckPoint", size, 0, [&] {
+        int count = 0;
+        for (int y = 0; y < size.height; y++) {
+            for (int x = 0; x < size.width; x++) {
+                count += !quadCheckPoint(cvPoint(x, y), quad);
+            }
+        }
+        inside = count;
+    }, 20);
+    benchRun("quadSpansContains", size, 0, [&] {
+        int count = 0;
+        for (int y = 0; y < size.height; y++) {
+            for (int x = 0; x < size.width; x++) {
+                count += spans.contains(cvPoint(x, y));
+            }
+        }
+        inside = count;
+    }, 20);
+
+    benchRun("quadSpansBuild", size, 0, [&] {
+        spans.build(quad, size);
+    });
+
+    auto rgb = reinterpret_cast<uint8_t*>(frame->imageData);
+    benchRun("RGBtoIplImage", size, pixels * 3, [&] {
+        RGBtoIplImage(rgb, size.width, size.height, workspace);
+    });
+    benchRun("RGBtoIplImage_copy", size, pixels * 3, [&] {
+        IplImage* image = RGBtoIplImage(rgb, size.width, size.height);
+        cvReleaseImage(&image);
+    });
+
+    pyramidAccuracy(size, spans, workspace);
+
+    cvReleaseImage(&frame);
+    cvReleaseImage(&redCalib);
+    cvReleaseImage(&blueCalib);
+    cvReleaseImage(&mask);
+}
@@ -0,0 +1,55 @@
+//=============================================================================
+//File Name: TrackerBench.cpp
+//Description: Benchmarks following pointers from frame to frame
+//Author: Tyler Veness
+//=============================================================================
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.hpp"
+#include "../src/CKinect/ContactTracker.hpp"
+
+void trackerBench(CvSize size) {
+    const unsigned int counts[] = {1, 12, CONTACT_MAX};
+
+    for (auto count : counts) {
+        std::mt19937 rng(count);
+
+        // Pointers spread over the frame, each drifting in its own direction
+        std::vector<CvPoint2D32f> position;
+        std::vector<CvPoint2D32f> velocity;
+        for (unsigned int i = 0; i < count; i++) {
+            position.push_back(cvPoint2D32f(rng() % size.width,
+                                            rng() % size.height));
+            velocity.push_back(cvPoint2D32f(static_cast<int>(rng() % 9) - 4,
+                                            static_cast<int>(rng() % 9) - 4));
+        }
+
+        ContactTracker tracker;
+        std::vector<CvPoint> points;
+        std::vector<Contact> contacts;
+        points.reserve(CONTACT_MAX);
+        contacts.reserve(2 * CONTACT_MAX);
+
+        uint64_t time = 0;
+        std::string name = "contactTracker_" + std::to_string(count);
+        benchRun(name.c_str(), size, 0, [&] {
+            time += 33333333;
+
+            points.clear();
+            for (unsigned int i = 0; i < count; i++) {
+                position[i].x += velocity[i].x;
+                position[i].y += velocity[i].y;
+
+                // Every so often a pointer goes unseen for a frame
+                if (rng() % 16 != 0) {
+                    points.push_back(cvPoint(position[i].x, position[i].y));
+                }
+            }
+
+            tracker.update(points, time, contacts);
+        });
+    }
+}
@@ -0,0 +1,224 @@
+//=============================================================================
+//File Name: kinectboardd.cpp
+//Description: Runs the tracking pipeline without a GUI and writes the
+//             pointers it finds to stdout or a uinput device
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * Usage: kinectboardd -q x0,y0,x1,y1,x2,y2,x3,y3 [options]
+ *
+ * There's no test pattern to calibrate against, so the corners of the screen
+ * in the Kinect's RGB image are given with -q (in any order).
+ *
+ * -d index     Use the Kinect at index (default 0)
+ * -s serial    Use the Kinect with the given serial number
+ * -l           List the connected Kinects and exit
+ * -r file      Replay a recording instead of using a Kinect
+ * -S WxH       Size of the screen in pixels (default 1920x1080)
+ * -f fps       Most frames per second to track (default every frame)
+ * -p level     Pyramid level for the search (0, 1 or 2)
+ * -m           Follow every pointer instead of only one
+ * -t           Detect touches in the depth image too
+ * -u           Move a uinput pointing device instead of writing to stdout
+ *
+ * Each pointer is written as one line:
+ *   timestamp id state x y
+ * where state is 0 (down), 1 (move) or 2 (up) and x and y are in [0, 65535].
+ */
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "../src/KinectCore.hpp"
+#include "../src/CKinect/UinputSink.hpp"
+
+// Writes every pointer the pipeline finds to stdout
+class PrintSink : public PointerSink {
+public:
+    int submit(const PointerEvent* events, unsigned int count) override {
+        for (unsigned int i = 0; i < count; i++) {
+            const PointerEvent& event = events[i];
+
+            for (unsigned int j = 0; j < event.contactCount; j++) {
+                const Contact& contact = event.contacts[j];
+                std::printf("%u %u %d %d %d\n", event.timestamp, contact.id,
+                            contact.state, contact.point.x, contact.point.y);
+            }
+        }
+
+        // One flush per batch
+        std::fflush(stdout);
+
+        return 0;
+    }
+};
+
+static std::atomic<bool> gRunning{true};
+
+static void stopRunning(int signal) {
+    gRunning = false;
+}
+
+// Parses "x0,y0,x1,y1,x2,y2,x3,y3" into corners. Returns 0 on success.
+static int parseQuad(const char* text, CvPoint corners[4]) {
+    int n = std::sscanf(text, "%d,%d,%d,%d,%d,%d,%d,%d",
+                        &corners[0].x, &corners[0].y,
+                        &corners[1].x, &corners[1].y,
+                        &corners[2].x, &corners[2].y,
+                        &corners[3].x, &corners[3].y);
+    return n == 8 ? 0 : 1;
+}
+
+static void usage(const char* name) {
+    std::fprintf(stderr, "usage: %s -q x0,y0,x1,y1,x2,y2,x3,y3 [-d index | "
+                 "-s serial | -r file] [-S WxH] [-f fps] [-p level] [-m] "
+                 "[-t] [-u]\n       %s -l\n", name, name);
+}
+
+int main(int argc, char* argv[]) {
+    int deviceIndex = 0;
+    std::string serial;
+    std::string replayFile;
+    CvPoint corners[4];
+    bool haveQuad = false;
+    int screenWidth = 1920;
+    int screenHeight = 1080;
+    unsigned int fps = 0;
+    int pyramidLevel = 0;
+    bool multiPointer = false;
+    bool touch = false;
+    bool uinput = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:lr:q:S:f:p:mtu")) != -1) {
+        switch (opt) {
+        case 'd':
+            deviceIndex = std::atoi(optarg);
+            break;
+        case 's':
+            serial = optarg;
+            break;
+        case 'l':
+            for (const auto& name : KinectCore::listDevices()) {
+                std::printf("%s\n", name.c_str());
+            }
+            return 0;
+        case 'r':
+            replayFile = optarg;
+            break;
+        case 'q':
+            if (parseQuad(optarg, corners) != 0) {
+                std::fprintf(stderr, "invalid screen corners: %s\n", optarg);
+                return 1;
+            }
+            haveQuad = true;
+            break;
+        case 'S':
+            if (std::sscanf(optarg, "%dx%d", &screenWidth, &screenHeight) != 2 ||
+                    screenWidth <= 0 || screenHeight <= 0) {
+                std::fprintf(stderr, "invalid screen size: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            fps = std::atoi(optarg);
+            break;
+        case 'p':
+            pyramidLevel = std::atoi(optarg);
+            break;
+        case 'm':
+            multiPointer = true;
+            break;
+        case 't':
+            touch = true;
+            break;
+        case 'u':
+            uinput = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!haveQuad) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::shared_ptr<PointerSink> sink;
+    if (uinput) {
+        auto device = std::make_shared<UinputSink>();
+        if (device->open() != 0) {
+            return 1;
+        }
+        sink = device;
+    }
+    else {
+        sink = std::make_shared<PrintSink>();
+    }
+
+    std::signal(SIGINT, stopRunning);
+    std::signal(SIGTERM, stopRunning);
+
+    std::unique_ptr<KinectCore> device;
+    if (serial.empty()) {
+        device = std::make_unique<KinectCore>(deviceIndex);
+    }
+    else {
+        device = std::make_unique<KinectCore>(serial);
+    }
+    KinectCore& kinect = *device;
+
+    kinect.setPointerSink(sink);
+    kinect.setScreenRect(cvRect(0, 0, screenWidth, screenHeight));
+    kinect.setTrackingFPS(fps);
+    kinect.setPyramidLevel(pyramidLevel);
+    kinect.setMultiPointer(multiPointer);
+    kinect.setTouchDetection(touch);
+
+    if (!kinect.setScreenQuad(corners)) {
+        std::fprintf(stderr, "screen corners don't make a quadrilateral\n");
+        return 1;
+    }
+
+    if (!replayFile.empty()) {
+        if (!kinect.startReplay(replayFile)) {
+            std::fprintf(stderr, "failed to replay %s\n", replayFile.c_str());
+            return 1;
+        }
+    }
+    else {
+        kinect.startVideoStream();
+        if (touch) {
+            kinect.startDepthStream();
+        }
+
+        if (!kinect.isVideoStreamRunning()) {
+            return 1;
+        }
+    }
+
+    // Run until we're told to stop, the device goes away or the replay ends
+    while (gRunning && kinect.isVideoStreamRunning() &&
+           (replayFile.empty() || kinect.isReplaying())) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    PipelineStats stats = kinect.getPipelineStats();
+    std::fprintf(stderr, "dropped: capture %u, detect %u, output %u, "
+                 "coalesced %u\n", stats.capture, stats.detect, stats.output,
+                 stats.coalesced);
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/* Connected-component labeling of binary masks. Finds the blobs in a mask and
+   their statistics in one pass over it, without tracing contours. */
+
+#include <algorithm>
+#include <cstring>
+
+#include "BlobLabel.hpp"
+
+/* Returns the offset of the first byte in [x, end) of row that is zero
+ * (if nonzero is false) or nonzero (if nonzero is true), or end if there is
+ * none. Whole words of background or foreground are skipped at once, since
+ * masks are mostly long stretches of one or the other.
+ */
+static int scanRow(const uint8_t* row, int x, int end, bool nonzero) {
+    const uint64_t skip = nonzero ? 0 : ~static_cast<uint64_t>(0);
+
+    while (x + 8 <= end) {
+        uint64_t word;
+        std::memcpy(&word, row + x, sizeof(word));
+        if (word != skip) {
+            break;
+        }
+        x += 8;
+    }
+
+    while (x < end && (row[x] != 0) != nonzero) {
+        x++;
+    }
+
+    return x;
+}
+
+void BlobLabeler::label(const uint8_t* mask, int stride, CvRect region,
+                        std::vector<Blob>& blobs) {
+    blobs.clear();
+    m_prevRuns.clear();
+    m_parents.clear();
+    m_stats.clear();
+
+    int right = region.x + region.width;
+
+    for (int y = region.y; y < region.y + region.height; y++) {
+        const uint8_t* row = mask + y * stride;
+
+        m_runs.clear();
+
+        // Runs on the previous row that can still touch the current run
+        unsigned int prev = 0;
+
+        int x = region.x;
+        while (true) {
+            x = scanRow(row, x, right, true);
+            if (x == right) {
+                break;
+            }
+
+            Run run;
+            run.x0 = x;
+            x = scanRow(row, x, right, false);
+            run.x1 = x - 1;
+            run.label = -1;
+
+            /* Runs on both rows are sorted, so skip the previous row's runs
+             * that end too far left to touch this one (diagonals count)
+             */
+            while (prev < m_prevRuns.size() &&
+                   m_prevRuns[prev].x1 < run.x0 - 1) {
+                prev++;
+            }
+
+            for (unsigned int i = prev; i < m_prevRuns.size() &&
+                 m_prevRuns[i].x0 <= run.x1 + 1; i++) {
+                if (run.label == -1) {
+                    run.label = find(m_prevRuns[i].label);
+                }
+                else {
+                    run.label = merge(run.label, m_prevRuns[i].label);
+                }
+            }
+
+            if (run.label == -1) {
+                run.label = m_parents.size();
+                m_parents.push_back(run.label);
+                m_stats.push_back({0, 0, 0, run.x0, run.x1, y, y});
+            }
+
+            /* Accumulate into the label the run was given. If that label is
+             * merged into another later, its sums are moved over at the end.
+             */
+            int length = run.x1 - run.x0 + 1;
+            Stats& stats = m_stats[run.label];
+            stats.area += length;
+            stats.sumX += static_cast<int64_t>(run.x0 + run.x1) * length / 2;
+            stats.sumY += static_cast<int64_t>(y) * length;
+            stats.minX = std::min(stats.minX, run.x0);
+            stats.maxX = std::max(stats.maxX, run.x1);
+            stats.minY = std::min(stats.minY, y);
+            stats.maxY = std::max(stats.maxY, y);
+
+            m_runs.push_back(run);
+        }
+
+        std::swap(m_prevRuns, m_runs);
+    }
+
+    // Fold the sums of every merged label into its set's root
+    for (unsigned int i = 0; i < m_parents.size(); i++) {
+        int root = find(i);
+        if (root == static_cast<int>(i)) {
+            continue;
+        }
+
+        Stats& from = m_stats[i];
+        Stats& to = m_stats[root];
+        to.area += from.area;
+        to.sumX += from.sumX;
+        to.sumY += from.sumY;
+        to.minX = std::min(to.minX, from.minX);
+        to.maxX = std::max(to.maxX, from.maxX);
+        to.minY = std::min(to.minY, from.minY);
+        to.maxY = std::max(to.maxY, from.maxY);
+    }
+
+    for (unsigned int i = 0; i < m_parents.size(); i++) {
+        if (m_parents[i] != static_cast<int>(i)) {
+            continue;
+        }
+
+        const Stats& stats = m_stats[i];
+
+        Blob blob;
+        blob.area = stats.area;
+        blob.bounds = cvRect(stats.minX, stats.minY,
+                             stats.maxX - stats.minX + 1,
+                             stats.maxY - stats.minY + 1);
+        blob.x = static_cast<float>(stats.sumX) / stats.area;
+        blob.y = static_cast<float>(stats.sumY) / stats.area;
+        blobs.push_back(blob);
+    }
+}
+
+int BlobLabeler::find(int label) {
+    // Path halving
+    while (m_parents[label] != label) {
+        m_parents[label] = m_parents[m_parents[label]];
+        label = m_parents[label];
+    }
+
+    return label;
+}
+
+int BlobLabeler::merge(int a, int b) {
+    a = find(a);
+    b = find(b);
+
+    if (a < b) {
+        m_parents[b] = a;
+        return a;
+    }
+    else {
+        m_parents[a] = b;
+        return b;
+    }
+}
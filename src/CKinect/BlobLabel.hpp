@@ -0,0 +1,74 @@
+/* Connected-component labeling of binary masks. Finds the blobs in a mask and
+   their statistics in one pass over it, without tracing contours. */
+
+#ifndef BLOB_LABEL_HPP
+#define BLOB_LABEL_HPP
+
+#include <opencv2/core/core_c.h>
+#include <cstdint>
+#include <vector>
+
+class Blob {
+public:
+    // Number of pixels in the blob
+    int area;
+
+    CvRect bounds;
+
+    // Centroid, to a fraction of a pixel
+    float x;
+    float y;
+};
+
+/* Labels the 8-connected regions of nonzero pixels in a mask. Each row is
+ * split into runs of nonzero pixels, and runs touching a run on the previous
+ * row are merged with a union-find over their labels. Area, bounding box and
+ * first-order moments are summed per run as it's found, so no second pass
+ * over the pixels is needed.
+ *
+ * The scratch storage is kept between calls, so labeling frames of a similar
+ * size doesn't allocate once it has grown to fit them.
+ */
+class BlobLabeler {
+public:
+    /* Finds the blobs in region of mask. stride is the distance in bytes
+     * between rows. blobs is cleared and filled in the order the blobs'
+     * first rows were reached. Coordinates are relative to mask, not region.
+     */
+    void label(const uint8_t* mask, int stride, CvRect region,
+               std::vector<Blob>& blobs);
+
+private:
+    class Run {
+    public:
+        int x0;
+        int x1; // Inclusive
+        int label;
+    };
+
+    class Stats {
+    public:
+        int area;
+        int64_t sumX;
+        int64_t sumY;
+        int minX;
+        int maxX;
+        int minY;
+        int maxY;
+    };
+
+    // Runs of the previous and current rows
+    std::vector<Run> m_prevRuns;
+    std::vector<Run> m_runs;
+
+    // Union-find forest over the labels; roots are their own parent
+    std::vector<int> m_parents;
+    std::vector<Stats> m_stats;
+
+    int find(int label);
+
+    // Merges the sets containing a and b; returns the new root
+    int merge(int a, int b);
+};
+
+#endif // BLOB_LABEL_HPP
@@ -0,0 +1,109 @@
+/* Per-pixel model of how often each pixel of the color mask is set, used to
+   ignore things in the room that are always the pointer's color (posters,
+   clothing) so they never reach blob extraction. */
+
+#include <algorithm>
+#include <cstring>
+
+#include "ColorBackground.hpp"
+
+void ColorBackground::resize(CvSize size) {
+    if (m_model != nullptr && m_size.width == size.width &&
+            m_size.height == size.height) {
+        return;
+    }
+
+    m_size = size;
+    m_model = std::make_unique<uint16_t[]>(size.width * size.height);
+}
+
+/* Tests one span of a row of the mask against the model and updates the
+ * model. Written without branches on the pixel values so the compiler can
+ * vectorize it.
+ */
+static void applySpan(uint8_t* mask, uint16_t* model, int count) {
+    for (int x = 0; x < count; x++) {
+        int m = mask[x];
+        int b = model[x];
+
+        // Widen 0x00/0xff to 0x0000/0xffff
+        int target = m * 257;
+
+        mask[x] = static_cast<uint8_t>(b < COLORBG_THRESHOLD ? m : 0);
+        model[x] = static_cast<uint16_t>(b + ((target - b) >> COLORBG_RATE_SHIFT));
+    }
+}
+
+// Same as applySpan(), but leaves the model as it is
+static void testSpan(uint8_t* mask, const uint16_t* model, int count) {
+    for (int x = 0; x < count; x++) {
+        int m = mask[x];
+        mask[x] = static_cast<uint8_t>(model[x] < COLORBG_THRESHOLD ? m : 0);
+    }
+}
+
+void ColorBackground::apply(IplImage* mask, const QuadSpans& spans) {
+    apply(mask, spans, cvRect(0, 0, 0, 0));
+}
+
+void ColorBackground::apply(IplImage* mask, const QuadSpans& spans,
+                            CvRect hold) {
+    apply(mask, spans, &hold, 1);
+}
+
+void ColorBackground::apply(IplImage* mask, const QuadSpans& spans,
+                            const CvRect* holds, unsigned int count) {
+    // Sort the holds by their left edge so each row is walked once
+    CvRect sorted[COLORBG_MAX_HOLDS];
+    count = std::min(count, static_cast<unsigned int>(COLORBG_MAX_HOLDS));
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int j = i;
+        for (; j > 0 && sorted[j - 1].x > holds[i].x; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = holds[i];
+    }
+
+    for (int y = spans.top; y <= spans.bottom; y++) {
+        int x0 = spans.left[y];
+        int x1 = spans.right[y];
+
+        if (x0 > x1) {
+            continue;
+        }
+
+        uint8_t* row = reinterpret_cast<uint8_t*>(mask->imageData +
+                                                  y * mask->widthStep);
+        uint16_t* model = m_model.get() + y * m_size.width;
+
+        // First pixel of the span not handled yet
+        int x = x0;
+
+        for (unsigned int i = 0; i < count; i++) {
+            const CvRect& hold = sorted[i];
+            if (y < hold.y || y >= hold.y + hold.height) {
+                continue;
+            }
+
+            // Part of the span inside this hold and not inside an earlier one
+            int h0 = std::max(x, hold.x);
+            int h1 = std::min(x1, hold.x + hold.width - 1);
+            if (h0 > h1) {
+                continue;
+            }
+
+            applySpan(row + x, model + x, h0 - x);
+            testSpan(row + h0, model + h0, h1 - h0 + 1);
+            x = h1 + 1;
+        }
+
+        applySpan(row + x, model + x, x1 - x + 1);
+    }
+}
+
+void ColorBackground::reset() {
+    if (m_model != nullptr) {
+        std::memset(m_model.get(), 0,
+                    m_size.width * m_size.height * sizeof(uint16_t));
+    }
+}
@@ -0,0 +1,67 @@
+/* Per-pixel model of how often each pixel of the color mask is set, used to
+   ignore things in the room that are always the pointer's color (posters,
+   clothing) so they never reach blob extraction. */
+
+#ifndef COLOR_BACKGROUND_HPP
+#define COLOR_BACKGROUND_HPP
+
+#include <cstdint>
+#include <memory>
+
+#include "Parse.hpp"
+
+/* The model is an exponentially weighted moving average of the mask in 16-bit
+ * fixed point, where 65535 means always set. Each frame moves it
+ * 1 / (1 << COLORBG_RATE_SHIFT) of the way toward the new mask.
+ */
+#define COLORBG_RATE_SHIFT 9
+
+/* Pixels set at least this often (in the model's fixed point) are background.
+ * At the default rate, a pixel that stays set becomes background after about
+ * 12 seconds at 30 fps; a pointer that only passes over it never does. A
+ * pointer held still for that long would, so the model isn't updated around
+ * a pointer that's being tracked (see apply()).
+ */
+#define COLORBG_THRESHOLD 32768
+
+// Most hold rectangles apply() takes at once; any beyond these are learned
+#define COLORBG_MAX_HOLDS 16
+
+class ColorBackground {
+public:
+    ColorBackground() = default;
+
+    ColorBackground(const ColorBackground&) = delete;
+    ColorBackground& operator=(const ColorBackground&) = delete;
+
+    /* Makes sure the model matches the given mask size. The model is only
+     * reallocated, and forgotten, if the size changes.
+     */
+    void resize(CvSize size);
+
+    /* Updates the model with the pixels of mask inside spans, and clears the
+     * ones that are background. mask must be the size given to resize().
+     */
+    void apply(IplImage* mask, const QuadSpans& spans);
+
+    /* Same as above, but the pixels inside hold are only tested against the
+     * model, not learned. Used to keep a pointer that isn't moving from
+     * becoming background.
+     */
+    void apply(IplImage* mask, const QuadSpans& spans, CvRect hold);
+
+    // Same as above, with count holds, which may overlap
+    void apply(IplImage* mask, const QuadSpans& spans, const CvRect* holds,
+               unsigned int count);
+
+    // Forgets everything learned
+    void reset();
+
+private:
+    CvSize m_size = {0, 0};
+
+    // One entry per mask pixel
+    std::unique_ptr<uint16_t[]> m_model;
+};
+
+#endif // COLOR_BACKGROUND_HPP
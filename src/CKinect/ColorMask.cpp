@@ -0,0 +1,521 @@
+/* Single-pass classification of packed RGB pixels into a binary color mask.
+   Replaces the RGB->HSV conversion and range checks imageFilter used to do
+   with OpenCV. */
+
+#include "ColorMask.hpp"
+#include "Parse.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define COLOR_MASK_X86
+#endif
+
+/* Every predicate below is derived from OpenCV's hue formula. With V the
+ * largest component and diff = V - min, the hue in degrees is
+ *   60 * (G - B) / diff        if R is largest
+ *   120 + 60 * (B - R) / diff  if G is largest
+ *   240 + 60 * (R - G) / diff  if B is largest
+ * so each hue range becomes a pair of linear inequalities in diff. OpenCV
+ * stores round(hue / 2) in 8-bit images, so H <= 10 means hue < 21 degrees,
+ * H >= 43 means hue >= 85 degrees, and so on. The bounds are exact; OpenCV's
+ * fixed-point division doesn't always land on the same side of them.
+ *
+ * Saturation is 255 * diff / V, so S >= 128 is 2 * diff >= V and S >= 64 is
+ * 4 * diff >= V.
+ */
+static inline bool classifyPixel(int r, int g, int b, int channel) {
+    int v = r > g ? r : g;
+    v = v > b ? v : b;
+    int mn = r < g ? r : g;
+    mn = mn < b ? mn : b;
+    int diff = v - mn;
+
+    switch (channel) {
+    case FLT_RED:
+        /* Hue below 21 degrees or at least 299 degrees. With R largest the
+         * hue is below 60 or at least 300 degrees, so only the low end needs
+         * checking. With B largest, only hues of 299 degrees and up match.
+         */
+        if (v < 128 || 2 * diff < v) {
+            return false;
+        }
+        if (r == v) {
+            return 20 * (g - b) < 7 * diff;
+        }
+        return g != v && 60 * (r - g) >= 59 * diff;
+    case FLT_GREEN:
+        // Hue in [85, 141) degrees
+        return v >= 128 && 2 * diff >= v && g == v && r != v &&
+               12 * (r - b) <= 7 * diff && 20 * (b - r) < 7 * diff;
+    case FLT_BLUE:
+        // Hue in [197, 267) degrees
+        return v >= 64 && 4 * diff >= v && b == v && r != v && g != v &&
+               60 * (g - r) <= 43 * diff && 20 * (r - g) < 9 * diff;
+    }
+
+    return false;
+}
+
+void colorMaskScalar(const uint8_t* rgb, uint8_t* mask, unsigned int pixels,
+                     int channel) {
+    for (unsigned int i = 0; i < pixels; i++) {
+        mask[i] = classifyPixel(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2],
+                                channel) ? 0xff : 0x00;
+    }
+}
+
+static void colorMaskStridedScalar(const uint8_t* rgb, uint8_t* mask,
+                                  unsigned int pixels, unsigned int step,
+                                  int channel) {
+    for (unsigned int i = 0; i < pixels; i++) {
+        const uint8_t* src = rgb + 3 * step * i;
+        mask[i] = classifyPixel(src[0], src[1], src[2], channel) ? 0xff : 0x00;
+    }
+}
+
+#ifdef COLOR_MASK_X86
+
+/* The vector kernels work on unsigned bytes for V, diff and the saturation
+ * test, and widen to signed 16-bit lanes only for the hue inequalities.
+ * a >= b on unsigned bytes is max(a, b) == a.
+ */
+
+// Hue test selector for the B-largest half of the red range
+#define HUE_RED_WRAP 0x04
+
+__attribute__((target("sse2")))
+static inline __m128i geU8(__m128i a, __m128i b) {
+    return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+}
+
+// Returns 0xffff in each lane where a * x - b * diff <= 0
+__attribute__((target("sse2")))
+static inline __m128i notAboveI16(__m128i x, int a, __m128i diff, int b) {
+    __m128i t = _mm_sub_epi16(_mm_mullo_epi16(x, _mm_set1_epi16(a)),
+                              _mm_mullo_epi16(diff, _mm_set1_epi16(b)));
+    return _mm_cmpeq_epi16(_mm_cmpgt_epi16(t, _mm_setzero_si128()),
+                           _mm_setzero_si128());
+}
+
+// Returns 0xffff in each lane where a * x - b * diff < 0
+__attribute__((target("sse2")))
+static inline __m128i belowI16(__m128i x, int a, __m128i diff, int b) {
+    __m128i t = _mm_sub_epi16(_mm_mullo_epi16(x, _mm_set1_epi16(a)),
+                              _mm_mullo_epi16(diff, _mm_set1_epi16(b)));
+    return _mm_cmpgt_epi16(_mm_setzero_si128(), t);
+}
+
+// Hue test for eight pixels widened to 16-bit lanes
+__attribute__((target("sse2")))
+static inline __m128i hueI16(__m128i r, __m128i g, __m128i b, __m128i diff,
+                             int channel) {
+    switch (channel) {
+    case FLT_RED:
+        return belowI16(_mm_sub_epi16(g, b), 20, diff, 7);
+    case HUE_RED_WRAP:
+        return notAboveI16(_mm_sub_epi16(g, r), 60, diff, -59);
+    case FLT_GREEN:
+        return _mm_and_si128(notAboveI16(_mm_sub_epi16(r, b), 12, diff, 7),
+                             belowI16(_mm_sub_epi16(b, r), 20, diff, 7));
+    default:
+        return _mm_and_si128(notAboveI16(_mm_sub_epi16(g, r), 60, diff, 43),
+                             belowI16(_mm_sub_epi16(r, g), 20, diff, 9));
+    }
+}
+
+// Runs a hue test on 16 pixels and narrows the result back to bytes
+__attribute__((target("sse2")))
+static inline __m128i packedHue16(__m128i r, __m128i g, __m128i b,
+                                  __m128i diff, int channel) {
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i hueLo = hueI16(_mm_unpacklo_epi8(r, zero),
+                           _mm_unpacklo_epi8(g, zero),
+                           _mm_unpacklo_epi8(b, zero),
+                           _mm_unpacklo_epi8(diff, zero), channel);
+    __m128i hueHi = hueI16(_mm_unpackhi_epi8(r, zero),
+                           _mm_unpackhi_epi8(g, zero),
+                           _mm_unpackhi_epi8(b, zero),
+                           _mm_unpackhi_epi8(diff, zero), channel);
+
+    return _mm_packs_epi16(hueLo, hueHi);
+}
+
+// Classifies 16 deinterleaved pixels
+__attribute__((target("sse2")))
+static inline __m128i classify16(__m128i r, __m128i g, __m128i b,
+                                 int channel) {
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i v = _mm_max_epu8(_mm_max_epu8(r, g), b);
+    __m128i mn = _mm_min_epu8(_mm_min_epu8(r, g), b);
+    __m128i diff = _mm_sub_epi8(v, mn);
+
+    // ceil(V / 2) and ceil(V / 4) via rounding averages with zero
+    __m128i halfV = _mm_avg_epu8(v, zero);
+
+    __m128i isR = _mm_cmpeq_epi8(r, v);
+    __m128i isG = _mm_andnot_si128(isR, _mm_cmpeq_epi8(g, v));
+    __m128i isB = _mm_andnot_si128(_mm_or_si128(isR, isG),
+                                   _mm_cmpeq_epi8(b, v));
+
+    __m128i result;
+    if (channel == FLT_BLUE) {
+        result = _mm_and_si128(geU8(v, _mm_set1_epi8(64)),
+                               geU8(diff, _mm_avg_epu8(halfV, zero)));
+    }
+    else {
+        result = _mm_and_si128(geU8(v, _mm_set1_epi8(static_cast<char>(128))),
+                               geU8(diff, halfV));
+    }
+
+    __m128i hue = packedHue16(r, g, b, diff, channel);
+    if (channel == FLT_RED) {
+        hue = _mm_or_si128(_mm_and_si128(isR, hue),
+                           _mm_and_si128(isB, packedHue16(r, g, b, diff,
+                                                          HUE_RED_WRAP)));
+    }
+    else {
+        hue = _mm_and_si128(hue, channel == FLT_GREEN ? isG : isB);
+    }
+
+    return _mm_and_si128(result, hue);
+}
+
+/* Splits 16 packed RGB pixels into one register per component using byte
+ * shuffles
+ */
+__attribute__((target("ssse3")))
+static inline void deinterleave16(const uint8_t* rgb, __m128i& r, __m128i& g,
+                                  __m128i& b) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb));
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 16));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 32));
+
+    r = _mm_or_si128(_mm_or_si128(
+        _mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1,
+                                          -1, -1, -1, -1, -1, -1)),
+        _mm_shuffle_epi8(m, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11,
+                                          14, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, -1, 1, 4, 7, 10, 13)));
+    g = _mm_or_si128(_mm_or_si128(
+        _mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1,
+                                          -1, -1, -1, -1, -1, -1)),
+        _mm_shuffle_epi8(m, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12,
+                                          15, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, -1, 2, 5, 8, 11, 14)));
+    b = _mm_or_si128(_mm_or_si128(
+        _mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1,
+                                          -1, -1, -1, -1, -1, -1)),
+        _mm_shuffle_epi8(m, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13,
+                                          -1, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, 0, 3, 6, 9, 12, 15)));
+}
+
+/* SSE2 has no byte shuffle, so the components are gathered through the stack
+ * before being classified 16 at a time
+ */
+__attribute__((target("sse2")))
+static void colorMaskSSE2(const uint8_t* rgb, uint8_t* mask,
+                          unsigned int pixels, int channel) {
+    alignas(16) uint8_t r[16];
+    alignas(16) uint8_t g[16];
+    alignas(16) uint8_t b[16];
+
+    unsigned int i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        const uint8_t* src = rgb + 3 * i;
+        for (unsigned int j = 0; j < 16; j++) {
+            r[j] = src[3 * j];
+            g[j] = src[3 * j + 1];
+            b[j] = src[3 * j + 2];
+        }
+
+        __m128i result = classify16(
+            _mm_load_si128(reinterpret_cast<const __m128i*>(r)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(g)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(b)), channel);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), result);
+    }
+
+    colorMaskScalar(rgb + 3 * i, mask + i, pixels - i, channel);
+}
+
+/* The sampled pixels aren't contiguous, so they're gathered through the stack
+ * the same way colorMaskSSE2() does it
+ */
+__attribute__((target("sse2")))
+static void colorMaskStridedSSE2(const uint8_t* rgb, uint8_t* mask,
+                                 unsigned int pixels, unsigned int step,
+                                 int channel) {
+    alignas(16) uint8_t r[16];
+    alignas(16) uint8_t g[16];
+    alignas(16) uint8_t b[16];
+
+    unsigned int i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        const uint8_t* src = rgb + 3 * step * i;
+        for (unsigned int j = 0; j < 16; j++) {
+            r[j] = src[3 * step * j];
+            g[j] = src[3 * step * j + 1];
+            b[j] = src[3 * step * j + 2];
+        }
+
+        __m128i result = classify16(
+            _mm_load_si128(reinterpret_cast<const __m128i*>(r)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(g)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(b)), channel);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), result);
+    }
+
+    colorMaskStridedScalar(rgb + 3 * step * i, mask + i, pixels - i, step,
+                           channel);
+}
+
+__attribute__((target("ssse3")))
+static void colorMaskSSSE3(const uint8_t* rgb, uint8_t* mask,
+                           unsigned int pixels, int channel) {
+    __m128i r;
+    __m128i g;
+    __m128i b;
+
+    unsigned int i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        deinterleave16(rgb + 3 * i, r, g, b);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i),
+                         classify16(r, g, b, channel));
+    }
+
+    colorMaskScalar(rgb + 3 * i, mask + i, pixels - i, channel);
+}
+
+/* Steps of 2 and 4 split 32 or 64 contiguous pixels with byte shuffles and
+ * keep every step'th one by narrowing the wider lanes holding them
+ */
+__attribute__((target("ssse3")))
+static void colorMaskStridedSSSE3(const uint8_t* rgb, uint8_t* mask,
+                                  unsigned int pixels, unsigned int step,
+                                  int channel) {
+    if (step != 2 && step != 4) {
+        colorMaskStridedSSE2(rgb, mask, pixels, step, channel);
+        return;
+    }
+
+    const __m128i low16 = _mm_set1_epi16(0x00ff);
+    const __m128i low32 = _mm_set1_epi32(0x000000ff);
+
+    __m128i r[4];
+    __m128i g[4];
+    __m128i b[4];
+
+    unsigned int i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        const uint8_t* src = rgb + 3 * step * i;
+        for (unsigned int j = 0; j < step; j++) {
+            deinterleave16(src + 48 * j, r[j], g[j], b[j]);
+        }
+
+        if (step == 4) {
+            for (unsigned int j = 0; j < 4; j += 2) {
+                r[j / 2] = _mm_packs_epi32(_mm_and_si128(r[j], low32),
+                                           _mm_and_si128(r[j + 1], low32));
+                g[j / 2] = _mm_packs_epi32(_mm_and_si128(g[j], low32),
+                                           _mm_and_si128(g[j + 1], low32));
+                b[j / 2] = _mm_packs_epi32(_mm_and_si128(b[j], low32),
+                                           _mm_and_si128(b[j + 1], low32));
+            }
+        }
+        else {
+            for (unsigned int j = 0; j < 2; j++) {
+                r[j] = _mm_and_si128(r[j], low16);
+                g[j] = _mm_and_si128(g[j], low16);
+                b[j] = _mm_and_si128(b[j], low16);
+            }
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i),
+                         classify16(_mm_packus_epi16(r[0], r[1]),
+                                    _mm_packus_epi16(g[0], g[1]),
+                                    _mm_packus_epi16(b[0], b[1]), channel));
+    }
+
+    colorMaskStridedScalar(rgb + 3 * step * i, mask + i, pixels - i, step,
+                           channel);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i geU8x32(__m256i a, __m256i b) {
+    return _mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i notAboveI16x16(__m256i x, int a, __m256i diff, int b) {
+    __m256i t = _mm256_sub_epi16(
+        _mm256_mullo_epi16(x, _mm256_set1_epi16(a)),
+        _mm256_mullo_epi16(diff, _mm256_set1_epi16(b)));
+    return _mm256_cmpeq_epi16(_mm256_cmpgt_epi16(t, _mm256_setzero_si256()),
+                              _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static inline __m256i belowI16x16(__m256i x, int a, __m256i diff, int b) {
+    __m256i t = _mm256_sub_epi16(
+        _mm256_mullo_epi16(x, _mm256_set1_epi16(a)),
+        _mm256_mullo_epi16(diff, _mm256_set1_epi16(b)));
+    return _mm256_cmpgt_epi16(_mm256_setzero_si256(), t);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hueI16x16(__m256i r, __m256i g, __m256i b, __m256i diff,
+                                int channel) {
+    switch (channel) {
+    case FLT_RED:
+        return belowI16x16(_mm256_sub_epi16(g, b), 20, diff, 7);
+    case HUE_RED_WRAP:
+        return notAboveI16x16(_mm256_sub_epi16(g, r), 60, diff, -59);
+    case FLT_GREEN:
+        return _mm256_and_si256(
+            notAboveI16x16(_mm256_sub_epi16(r, b), 12, diff, 7),
+            belowI16x16(_mm256_sub_epi16(b, r), 20, diff, 7));
+    default:
+        return _mm256_and_si256(
+            notAboveI16x16(_mm256_sub_epi16(g, r), 60, diff, 43),
+            belowI16x16(_mm256_sub_epi16(r, g), 20, diff, 9));
+    }
+}
+
+// Unpacking and packing both work per 128-bit lane, so pixel order is kept
+__attribute__((target("avx2")))
+static inline __m256i packedHue32(__m256i r, __m256i g, __m256i b,
+                                  __m256i diff, int channel) {
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i hueLo = hueI16x16(_mm256_unpacklo_epi8(r, zero),
+                              _mm256_unpacklo_epi8(g, zero),
+                              _mm256_unpacklo_epi8(b, zero),
+                              _mm256_unpacklo_epi8(diff, zero), channel);
+    __m256i hueHi = hueI16x16(_mm256_unpackhi_epi8(r, zero),
+                              _mm256_unpackhi_epi8(g, zero),
+                              _mm256_unpackhi_epi8(b, zero),
+                              _mm256_unpackhi_epi8(diff, zero), channel);
+
+    return _mm256_packs_epi16(hueLo, hueHi);
+}
+
+// Same as classify16() on 32 pixels
+__attribute__((target("avx2")))
+static inline __m256i classify32(__m256i r, __m256i g, __m256i b,
+                                 int channel) {
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i v = _mm256_max_epu8(_mm256_max_epu8(r, g), b);
+    __m256i mn = _mm256_min_epu8(_mm256_min_epu8(r, g), b);
+    __m256i diff = _mm256_sub_epi8(v, mn);
+    __m256i halfV = _mm256_avg_epu8(v, zero);
+
+    __m256i isR = _mm256_cmpeq_epi8(r, v);
+    __m256i isG = _mm256_andnot_si256(isR, _mm256_cmpeq_epi8(g, v));
+    __m256i isB = _mm256_andnot_si256(_mm256_or_si256(isR, isG),
+                                      _mm256_cmpeq_epi8(b, v));
+
+    __m256i result;
+    if (channel == FLT_BLUE) {
+        result = _mm256_and_si256(geU8x32(v, _mm256_set1_epi8(64)),
+                                  geU8x32(diff, _mm256_avg_epu8(halfV, zero)));
+    }
+    else {
+        result = _mm256_and_si256(
+            geU8x32(v, _mm256_set1_epi8(static_cast<char>(128))),
+            geU8x32(diff, halfV));
+    }
+
+    __m256i hue = packedHue32(r, g, b, diff, channel);
+    if (channel == FLT_RED) {
+        hue = _mm256_or_si256(
+            _mm256_and_si256(isR, hue),
+            _mm256_and_si256(isB, packedHue32(r, g, b, diff, HUE_RED_WRAP)));
+    }
+    else {
+        hue = _mm256_and_si256(hue, channel == FLT_GREEN ? isG : isB);
+    }
+
+    return _mm256_and_si256(result, hue);
+}
+
+__attribute__((target("avx2")))
+static void colorMaskAVX2(const uint8_t* rgb, uint8_t* mask,
+                          unsigned int pixels, int channel) {
+    __m128i r0, g0, b0;
+    __m128i r1, g1, b1;
+
+    unsigned int i = 0;
+    for (; i + 32 <= pixels; i += 32) {
+        deinterleave16(rgb + 3 * i, r0, g0, b0);
+        deinterleave16(rgb + 3 * i + 48, r1, g1, b1);
+
+        __m256i r = _mm256_inserti128_si256(_mm256_castsi128_si256(r0), r1, 1);
+        __m256i g = _mm256_inserti128_si256(_mm256_castsi128_si256(g0), g1, 1);
+        __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(b0), b1, 1);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + i),
+                            classify32(r, g, b, channel));
+    }
+
+    colorMaskScalar(rgb + 3 * i, mask + i, pixels - i, channel);
+}
+
+#endif // COLOR_MASK_X86
+
+typedef void (*ColorMaskFunc)(const uint8_t*, uint8_t*, unsigned int, int);
+typedef void (*ColorMaskStridedFunc)(const uint8_t*, uint8_t*, unsigned int,
+                                     unsigned int, int);
+
+static ColorMaskFunc selectColorMask() {
+#ifdef COLOR_MASK_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        return colorMaskAVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return colorMaskSSSE3;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return colorMaskSSE2;
+    }
+#endif
+
+    return colorMaskScalar;
+}
+
+void colorMask(const uint8_t* rgb, uint8_t* mask, unsigned int pixels,
+               int channel) {
+    static const ColorMaskFunc func = selectColorMask();
+
+    func(rgb, mask, pixels, channel);
+}
+
+static ColorMaskStridedFunc selectColorMaskStrided() {
+#ifdef COLOR_MASK_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("ssse3")) {
+        return colorMaskStridedSSSE3;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return colorMaskStridedSSE2;
+    }
+#endif
+
+    return colorMaskStridedScalar;
+}
+
+void colorMaskStrided(const uint8_t* rgb, uint8_t* mask, unsigned int pixels,
+                      unsigned int step, int channel) {
+    static const ColorMaskStridedFunc func = selectColorMaskStrided();
+
+    func(rgb, mask, pixels, step, channel);
+}
@@ -0,0 +1,43 @@
+/* Single-pass classification of packed RGB pixels into a binary color mask.
+   Replaces the RGB->HSV conversion and range checks imageFilter used to do
+   with OpenCV. */
+
+#ifndef COLOR_MASK_HPP
+#define COLOR_MASK_HPP
+
+#include <cstdint>
+
+/* Writes 0xff to mask for every pixel in rgb that matches the color given by
+ * channel (FLT_RED, FLT_GREEN or FLT_BLUE) and 0x00 otherwise. rgb holds
+ * 'pixels' packed 24-bit pixels in R, G, B order. The fastest implementation
+ * the CPU supports is chosen at runtime.
+ *
+ * The thresholds are those imageFilter used in OpenCV's 8-bit HSV space
+ * (H in [0, 180), S and V in [0, 255]), rewritten as integer comparisons on
+ * the RGB components so no hue is ever computed:
+ *   FLT_RED:   H in [0, 10] or [150, 180], S >= 128, V >= 128
+ *   FLT_GREEN: H in [43, 70],              S >= 128, V >= 128
+ *   FLT_BLUE:  H in [99, 133],             S >= 64,  V >= 64
+ * The comparisons use the exact hue, rounded to whole units the way OpenCV's
+ * formula says it should be. OpenCV itself divides in fixed point, which
+ * rounds differently right at the edges of a unit, so a few thousand of the
+ * 2^24 colors (e.g. rgb(126, 2, 128)) are classified differently than
+ * cvCvtColor followed by cvInRangeS did.
+ */
+void colorMask(const uint8_t* rgb, uint8_t* mask, unsigned int pixels,
+               int channel);
+
+/* Same as colorMask(), but only classifies every step'th pixel of rgb, so
+ * mask gets 'pixels' entries for pixels 0, step, 2 * step and so on. Used to
+ * decimate an image while classifying it, without a downsampled copy.
+ */
+void colorMaskStrided(const uint8_t* rgb, uint8_t* mask, unsigned int pixels,
+                      unsigned int step, int channel);
+
+/* Portable reference implementation of colorMask(). The vectorized versions
+ * produce identical output.
+ */
+void colorMaskScalar(const uint8_t* rgb, uint8_t* mask, unsigned int pixels,
+                     int channel);
+
+#endif // COLOR_MASK_HPP
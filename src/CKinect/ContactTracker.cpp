@@ -0,0 +1,211 @@
+/* Follows several pointers at once and gives each a stable ID. Each frame's
+   candidates are matched to the pointers already being followed with an
+   optimal assignment over their distances. */
+
+#include <algorithm>
+#include <cmath>
+
+#include "ContactTracker.hpp"
+
+ContactTracker::ContactTracker(uint32_t idBase) : m_idBase(idBase) {
+    const unsigned int n = CONTACT_MAX;
+
+    m_tracks.reserve(n);
+    m_cost.resize(n * n);
+    m_u.resize(n + 1);
+    m_v.resize(n + 1);
+    m_minv.resize(n + 1);
+    m_match.resize(n + 1);
+    m_way.resize(n + 1);
+    m_used.resize(n + 1);
+    m_rowMatch.resize(n);
+}
+
+void ContactTracker::update(const std::vector<CvPoint>& points, uint64_t time,
+                            std::vector<Contact>& contacts) {
+    contacts.clear();
+
+    unsigned int tracks = m_tracks.size();
+    unsigned int candidates = std::min<unsigned int>(points.size(),
+                                                     CONTACT_MAX);
+    unsigned int n = std::max(tracks, candidates);
+
+    const float gate = static_cast<float>(CONTACT_GATE) * CONTACT_GATE;
+
+    /* Pairs farther apart than the gate cost more than every pair inside it
+     * together, so the assignment matches as many pointers as it can within
+     * the gate before it minimizes the distances. Padding rows and columns
+     * cost nothing.
+     */
+    const float outside = gate * (n + 1);
+
+    for (unsigned int i = 0; i < n; i++) {
+        CvPoint2D32f predicted = cvPoint2D32f(0, 0);
+        if (i < tracks) {
+            predicted = m_tracks[i].filter.position(time);
+        }
+
+        for (unsigned int j = 0; j < n; j++) {
+            float cost = 0.f;
+
+            if (i < tracks && j < candidates) {
+                float dx = points[j].x - predicted.x;
+                float dy = points[j].y - predicted.y;
+                cost = dx * dx + dy * dy;
+                if (cost > gate) {
+                    cost = outside;
+                }
+            }
+
+            m_cost[i * n + j] = cost;
+        }
+    }
+
+    if (n > 0) {
+        assign(n);
+    }
+
+    // Candidates not taken by any pointer start new ones
+    bool taken[CONTACT_MAX] = {};
+
+    unsigned int kept = 0;
+    unsigned int lost = 0;
+    for (unsigned int i = 0; i < tracks; i++) {
+        Track& track = m_tracks[i];
+        int j = m_rowMatch[i];
+
+        if (j < static_cast<int>(candidates) &&
+                m_cost[i * n + j] < outside) {
+            taken[j] = true;
+
+            track.point = points[j];
+            track.filter.update(track.point, time);
+
+            Contact contact;
+            contact.id = track.id;
+            contact.state = CONTACT_MOVE;
+            contact.point = track.point;
+            contacts.push_back(contact);
+        }
+        else {
+            track.filter.miss();
+
+            if (!track.filter.isTracking()) {
+                Contact contact;
+                contact.id = track.id;
+                contact.state = CONTACT_UP;
+                contact.point = track.point;
+                contacts.push_back(contact);
+                lost++;
+
+                continue;
+            }
+        }
+
+        // Compact the pointers still being followed, keeping their order
+        if (kept != i) {
+            m_tracks[kept] = m_tracks[i];
+        }
+        kept++;
+    }
+    m_tracks.resize(kept);
+
+    /* Pointers lost this frame are still reported, so they count against
+     * CONTACT_MAX until the next frame. That keeps contacts from ever holding
+     * more than CONTACT_MAX entries.
+     */
+    for (unsigned int j = 0; j < candidates; j++) {
+        if (taken[j] || m_tracks.size() + lost >= CONTACT_MAX) {
+            continue;
+        }
+
+        Track track;
+        track.id = m_idBase + m_nextId++;
+        if (m_nextId == CONTACT_ID_SPACE) {
+            m_nextId = 1;
+        }
+        track.point = points[j];
+        track.filter.update(track.point, time);
+        m_tracks.push_back(track);
+
+        Contact contact;
+        contact.id = track.id;
+        contact.state = CONTACT_DOWN;
+        contact.point = track.point;
+        contacts.push_back(contact);
+    }
+}
+
+void ContactTracker::reset() {
+    m_tracks.clear();
+}
+
+unsigned int ContactTracker::size() const {
+    return m_tracks.size();
+}
+
+void ContactTracker::assign(unsigned int n) {
+    /* Shortest augmenting path form of the Hungarian algorithm with row and
+     * column potentials u and v. Rows and columns are numbered from 1;
+     * column 0 is a sentinel, and m_match[j] is the row matched to column j.
+     */
+    const float inf = HUGE_VALF;
+
+    std::fill(m_u.begin(), m_u.begin() + n + 1, 0.f);
+    std::fill(m_v.begin(), m_v.begin() + n + 1, 0.f);
+    std::fill(m_match.begin(), m_match.begin() + n + 1, 0);
+
+    for (unsigned int i = 1; i <= n; i++) {
+        m_match[0] = i;
+        unsigned int j0 = 0;
+
+        std::fill(m_minv.begin(), m_minv.begin() + n + 1, inf);
+        std::fill(m_used.begin(), m_used.begin() + n + 1, 0);
+
+        do {
+            m_used[j0] = 1;
+            unsigned int i0 = m_match[j0];
+            float delta = inf;
+            unsigned int j1 = 0;
+
+            for (unsigned int j = 1; j <= n; j++) {
+                if (m_used[j]) {
+                    continue;
+                }
+
+                float cur = m_cost[(i0 - 1) * n + (j - 1)] - m_u[i0] - m_v[j];
+                if (cur < m_minv[j]) {
+                    m_minv[j] = cur;
+                    m_way[j] = j0;
+                }
+                if (m_minv[j] < delta) {
+                    delta = m_minv[j];
+                    j1 = j;
+                }
+            }
+
+            for (unsigned int j = 0; j <= n; j++) {
+                if (m_used[j]) {
+                    m_u[m_match[j]] += delta;
+                    m_v[j] -= delta;
+                }
+                else {
+                    m_minv[j] -= delta;
+                }
+            }
+
+            j0 = j1;
+        } while (m_match[j0] != 0);
+
+        // Flip the augmenting path
+        do {
+            unsigned int j1 = m_way[j0];
+            m_match[j0] = m_match[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    for (unsigned int j = 1; j <= n; j++) {
+        m_rowMatch[m_match[j] - 1] = j - 1;
+    }
+}
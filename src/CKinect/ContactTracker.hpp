@@ -0,0 +1,98 @@
+/* Follows several pointers at once and gives each a stable ID. Each frame's
+   candidates are matched to the pointers already being followed with an
+   optimal assignment over their distances. */
+
+#ifndef CONTACT_TRACKER_HPP
+#define CONTACT_TRACKER_HPP
+
+#include <opencv2/core/core_c.h>
+#include <cstdint>
+#include <vector>
+
+#include "PointerTracker.hpp"
+
+/* Most pointers followed at once. Candidates beyond this many are ignored,
+ * which bounds the cost of the assignment per frame.
+ */
+#define CONTACT_MAX 16
+
+// Farthest a pointer can be from where it was predicted and still match
+#define CONTACT_GATE 48
+
+/* Trackers hand out IDs below CONTACT_ID_SPACE, plus the base they were
+ * created with. Trackers with different bases never give out the same ID.
+ */
+#define CONTACT_ID_SPACE 0x80000000u
+
+// Contact states
+#define CONTACT_DOWN 0 // First frame the pointer was seen
+#define CONTACT_MOVE 1
+#define CONTACT_UP 2 // The pointer was lost; point is where it was last seen
+
+class Contact {
+public:
+    /* Unique for as long as the pointer is followed, including among other
+     * trackers' contacts if their ID bases differ. Never 0.
+     */
+    uint32_t id = 0;
+
+    int state = CONTACT_DOWN;
+
+    // Position in the image
+    CvPoint point = {0, 0};
+};
+
+class ContactTracker {
+public:
+    /* IDs start at idBase + 1 and stay below idBase + CONTACT_ID_SPACE.
+     * idBase must be a multiple of CONTACT_ID_SPACE.
+     */
+    explicit ContactTracker(uint32_t idBase = 0);
+
+    /* Matches the candidate points from one frame to the pointers being
+     * followed and fills contacts with every pointer seen this frame and
+     * every one that was just lost. A pointer missed for a few frames is
+     * kept (but not reported) until it's been gone longer than
+     * TRACKER_MAX_MISSES frames. Contacts are in the order the pointers were
+     * first seen, and there are never more than CONTACT_MAX of them.
+     */
+    void update(const std::vector<CvPoint>& points, uint64_t time,
+                std::vector<Contact>& contacts);
+
+    // Forgets every pointer without reporting them as lost
+    void reset();
+
+    // Number of pointers being followed
+    unsigned int size() const;
+
+private:
+    class Track {
+    public:
+        uint32_t id;
+        PointerTracker filter;
+        CvPoint point;
+    };
+
+    std::vector<Track> m_tracks;
+    uint32_t m_idBase;
+    uint32_t m_nextId = 1;
+
+    // Scratch for assign(), sized for CONTACT_MAX on both sides
+    std::vector<float> m_cost;
+    std::vector<float> m_u;
+    std::vector<float> m_v;
+    std::vector<float> m_minv;
+    std::vector<int> m_match;
+    std::vector<int> m_way;
+    std::vector<char> m_used;
+
+    // Column assigned to each row of the assignment
+    std::vector<int> m_rowMatch;
+
+    /* Solves the assignment problem for the n by n matrix in m_cost with the
+     * Hungarian algorithm in O(n^3), filling m_rowMatch
+     */
+    void assign(unsigned int n);
+};
+
+#endif // CONTACT_TRACKER_HPP
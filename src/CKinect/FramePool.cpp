@@ -0,0 +1,135 @@
+/* A fixed set of aligned frame buffers handed between threads by
+   reference-counted handles, so frames can be passed from the capture
+   callback to consumers without copying them. */
+
+#include "FramePool.hpp"
+
+FrameRef::FrameRef(Frame* frame) : m_frame(frame) {
+}
+
+FrameRef::FrameRef(const FrameRef& rhs) : m_frame(rhs.m_frame) {
+    if (m_frame != nullptr) {
+        m_frame->m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FrameRef::FrameRef(FrameRef&& rhs) noexcept : m_frame(rhs.m_frame) {
+    rhs.m_frame = nullptr;
+}
+
+FrameRef::~FrameRef() {
+    reset();
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& rhs) {
+    if (m_frame != rhs.m_frame) {
+        // Take the new reference before dropping the old one
+        if (rhs.m_frame != nullptr) {
+            rhs.m_frame->m_refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        reset();
+        m_frame = rhs.m_frame;
+    }
+
+    return *this;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& rhs) noexcept {
+    if (this != &rhs) {
+        reset();
+        m_frame = rhs.m_frame;
+        rhs.m_frame = nullptr;
+    }
+
+    return *this;
+}
+
+void FrameRef::reset() {
+    if (m_frame != nullptr) {
+        /* Release ordering publishes this thread's writes to the frame before
+         * the pool can hand it out again
+         */
+        m_frame->m_refs.fetch_sub(1, std::memory_order_release);
+        m_frame = nullptr;
+    }
+}
+
+uint8_t* FrameRef::data() const {
+    return m_frame != nullptr ? m_frame->data : nullptr;
+}
+
+uint32_t FrameRef::timestamp() const {
+    return m_frame != nullptr ? m_frame->timestamp : 0;
+}
+
+void FrameRef::setTimestamp(uint32_t timestamp) {
+    if (m_frame != nullptr) {
+        m_frame->timestamp = timestamp;
+    }
+}
+
+uint64_t FrameRef::captureTime() const {
+    return m_frame != nullptr ? m_frame->captureTime : 0;
+}
+
+void FrameRef::setCaptureTime(uint64_t captureTime) {
+    if (m_frame != nullptr) {
+        m_frame->captureTime = captureTime;
+    }
+}
+
+FrameRef::operator bool() const {
+    return m_frame != nullptr;
+}
+
+FramePool::FramePool(size_t frameSize, unsigned int count) :
+        m_frameSize(frameSize),
+        m_count(count) {
+    // Round each frame up to a whole number of cache lines
+    size_t stride = (frameSize + alignment - 1) / alignment * alignment;
+
+    m_memory = std::make_unique<uint8_t[]>(stride * count + alignment);
+    m_frames = std::make_unique<Frame[]>(count);
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(m_memory.get());
+    base = (base + alignment - 1) / alignment * alignment;
+
+    for (unsigned int i = 0; i < count; i++) {
+        m_frames[i].data = reinterpret_cast<uint8_t*>(base + i * stride);
+    }
+}
+
+FrameRef FramePool::acquire() {
+    for (unsigned int i = 0; i < m_count; i++) {
+        int expected = 0;
+
+        // Claim the first frame nobody references
+        if (m_frames[i].m_refs.compare_exchange_strong(
+                expected, 1, std::memory_order_acquire,
+                std::memory_order_relaxed)) {
+            return FrameRef(&m_frames[i]);
+        }
+    }
+
+    return FrameRef();
+}
+
+unsigned int FramePool::available() const {
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < m_count; i++) {
+        if (m_frames[i].m_refs.load(std::memory_order_relaxed) == 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+size_t FramePool::frameSize() const {
+    return m_frameSize;
+}
+
+unsigned int FramePool::size() const {
+    return m_count;
+}
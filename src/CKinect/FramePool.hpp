@@ -0,0 +1,101 @@
+/* A fixed set of aligned frame buffers handed between threads by
+   reference-counted handles, so frames can be passed from the capture
+   callback to consumers without copying them. */
+
+#ifndef FRAME_POOL_HPP
+#define FRAME_POOL_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+class FramePool;
+class FrameRef;
+
+class Frame {
+public:
+    // Start of the frame's pixel data (aligned to FramePool::alignment)
+    uint8_t* data = nullptr;
+
+    // Device timestamp of the frame
+    uint32_t timestamp = 0;
+
+    // latencyClock() time the frame arrived from the device (0 if unknown)
+    uint64_t captureTime = 0;
+
+private:
+    // A frame with no references is free to be handed out by its pool
+    std::atomic<int> m_refs{0};
+
+    friend class FramePool;
+    friend class FrameRef;
+};
+
+/* Handle to a frame in a FramePool. Copying a handle adds a reference and
+ * destroying one drops it. The frame returns to its pool when the last handle
+ * to it goes away. Handles must not outlive the pool.
+ */
+class FrameRef {
+public:
+    FrameRef() = default;
+    FrameRef(const FrameRef& rhs);
+    FrameRef(FrameRef&& rhs) noexcept;
+    ~FrameRef();
+
+    FrameRef& operator=(const FrameRef& rhs);
+    FrameRef& operator=(FrameRef&& rhs) noexcept;
+
+    // Drops this handle's reference
+    void reset();
+
+    uint8_t* data() const;
+
+    uint32_t timestamp() const;
+    void setTimestamp(uint32_t timestamp);
+
+    uint64_t captureTime() const;
+    void setCaptureTime(uint64_t captureTime);
+
+    // Returns true if the handle refers to a frame
+    explicit operator bool() const;
+
+private:
+    Frame* m_frame = nullptr;
+
+    // Adopts a reference already taken on frame
+    explicit FrameRef(Frame* frame);
+
+    friend class FramePool;
+};
+
+class FramePool {
+public:
+    // Frame buffers start on cache line boundaries
+    static const size_t alignment = 64;
+
+    FramePool(size_t frameSize, unsigned int count);
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /* Returns a handle to a free frame, or an empty handle if every frame is
+     * in use. Never blocks or allocates.
+     */
+    FrameRef acquire();
+
+    // Returns the number of frames not currently referenced by any handle
+    unsigned int available() const;
+
+    size_t frameSize() const;
+    unsigned int size() const;
+
+private:
+    size_t m_frameSize;
+    unsigned int m_count;
+
+    std::unique_ptr<uint8_t[]> m_memory;
+    std::unique_ptr<Frame[]> m_frames;
+};
+
+#endif // FRAME_POOL_HPP
@@ -0,0 +1,74 @@
+/* Bounded queue connecting the stages of the frame processing pipeline.
+   Pushing never waits for the consumer; when the queue is full an item is
+   dropped according to the queue's drop policy and counted. */
+
+#ifndef FRAME_QUEUE_HPP
+#define FRAME_QUEUE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Drop policies
+#define FRAMEQUEUE_DROP_OLDEST 0 // Latest wins: a full queue discards its oldest item
+#define FRAMEQUEUE_DROP_NEWEST 1 // A full queue rejects the item being pushed
+
+template <class T>
+class FrameQueue {
+public:
+    explicit FrameQueue(unsigned int capacity,
+                        int dropPolicy = FRAMEQUEUE_DROP_OLDEST);
+
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    /* Adds an item to the back of the queue. Returns false if an item had to
+     * be dropped to stay within capacity. Never waits on the consumer.
+     */
+    bool push(T item);
+
+    /* Waits for an item and moves it into item. Returns false once the queue
+     * has been closed.
+     */
+    bool pop(T& item);
+
+    /* Waits for an item, then moves every queued item into items (replacing
+     * its contents), oldest first. Returns false once the queue has been
+     * closed.
+     */
+    bool popAll(std::vector<T>& items);
+
+    /* Wakes up the consumer and makes all further calls to pop() return false.
+     * Queued items are discarded.
+     */
+    void close();
+
+    // Undoes close()
+    void open();
+
+    void setDropPolicy(int dropPolicy);
+
+    // Returns the number of items dropped since construction
+    unsigned int dropped() const;
+
+    unsigned int size();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    // Ring of preallocated slots
+    std::vector<T> m_slots;
+    unsigned int m_head = 0;
+    unsigned int m_count = 0;
+
+    int m_dropPolicy;
+    bool m_closed = false;
+
+    std::atomic<unsigned int> m_dropped{0};
+};
+
+#include "FrameQueue.inl"
+
+#endif // FRAME_QUEUE_HPP
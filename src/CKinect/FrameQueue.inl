@@ -0,0 +1,129 @@
+/*
+ * Bounded queue connecting the stages of the frame processing pipeline.
+ * Each slot is allocated up front, so pushing and popping never allocate.
+ * The mutex is only ever held for a few assignments; no processing happens
+ * while it's held, so the producer never waits on the consumer's work.
+ */
+
+template <class T>
+FrameQueue<T>::FrameQueue(unsigned int capacity, int dropPolicy) :
+        m_slots(capacity),
+        m_dropPolicy(dropPolicy) {
+}
+
+template <class T>
+bool FrameQueue<T>::push(T item) {
+    bool kept = true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_closed) {
+            return false;
+        }
+
+        unsigned int capacity = m_slots.size();
+
+        if (m_count == capacity) {
+            m_dropped++;
+            kept = false;
+
+            if (m_dropPolicy == FRAMEQUEUE_DROP_NEWEST) {
+                return false;
+            }
+
+            // Overwrite the oldest item and advance the head past it
+            m_slots[m_head] = std::move(item);
+            m_head = (m_head + 1) % capacity;
+        }
+        else {
+            m_slots[(m_head + m_count) % capacity] = std::move(item);
+            m_count++;
+        }
+    }
+
+    m_cond.notify_one();
+
+    return kept;
+}
+
+template <class T>
+bool FrameQueue<T>::pop(T& item) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_cond.wait(lock, [this] { return m_count > 0 || m_closed; });
+
+    if (m_closed) {
+        return false;
+    }
+
+    item = std::move(m_slots[m_head]);
+    m_slots[m_head] = T();
+    m_head = (m_head + 1) % m_slots.size();
+    m_count--;
+
+    return true;
+}
+
+template <class T>
+bool FrameQueue<T>::popAll(std::vector<T>& items) {
+    items.clear();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_cond.wait(lock, [this] { return m_count > 0 || m_closed; });
+
+    if (m_closed) {
+        return false;
+    }
+
+    while (m_count > 0) {
+        items.push_back(std::move(m_slots[m_head]));
+        m_slots[m_head] = T();
+        m_head = (m_head + 1) % m_slots.size();
+        m_count--;
+    }
+
+    return true;
+}
+
+template <class T>
+void FrameQueue<T>::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_closed = true;
+
+        // Release whatever the queued items hold
+        for (unsigned int i = 0; i < m_slots.size(); i++) {
+            m_slots[i] = T();
+        }
+        m_head = 0;
+        m_count = 0;
+    }
+
+    m_cond.notify_all();
+}
+
+template <class T>
+void FrameQueue<T>::open() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = false;
+}
+
+template <class T>
+void FrameQueue<T>::setDropPolicy(int dropPolicy) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dropPolicy = dropPolicy;
+}
+
+template <class T>
+unsigned int FrameQueue<T>::dropped() const {
+    return m_dropped;
+}
+
+template <class T>
+unsigned int FrameQueue<T>::size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
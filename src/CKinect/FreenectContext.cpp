@@ -0,0 +1,162 @@
+/* One libfreenect context shared by every Kinect in the process. It owns the
+   thread that handles USB events, so several devices can stream at once
+   without each needing a context and event loop of its own. */
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include "FreenectContext.hpp"
+
+FreenectContext::FreenectContext(freenect_context* context) :
+        m_context(context) {
+}
+
+FreenectContext::~FreenectContext() {
+    // Every device has been closed by now, which stopped the event thread
+    m_eventsRunning = false;
+    if (m_eventThread.joinable()) {
+        m_eventThread.join();
+    }
+
+    freenect_shutdown(m_context);
+}
+
+std::shared_ptr<FreenectContext> FreenectContext::get() {
+    static std::mutex mutex;
+    static std::weak_ptr<FreenectContext> shared;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::shared_ptr<FreenectContext> context = shared.lock();
+    if (context == nullptr) {
+        freenect_context* f_ctx;
+        if (freenect_init(&f_ctx, nullptr) != 0) {
+            std::fprintf(stderr, "failed to initialize libfreenect\n");
+            return nullptr;
+        }
+
+        context.reset(new FreenectContext(f_ctx));
+        shared = context;
+    }
+
+    return context;
+}
+
+int FreenectContext::deviceCount() {
+    return freenect_num_devices(m_context);
+}
+
+std::vector<std::string> FreenectContext::serials() {
+    std::vector<std::string> serials;
+
+    freenect_device_attributes* list;
+    if (freenect_list_device_attributes(m_context, &list) < 0) {
+        return serials;
+    }
+
+    for (freenect_device_attributes* item = list; item != nullptr;
+            item = item->next) {
+        serials.emplace_back(item->camera_serial != nullptr ?
+                             item->camera_serial : "");
+    }
+
+    freenect_free_device_attributes(list);
+
+    return serials;
+}
+
+int FreenectContext::openDevice(int index, const std::string& serial,
+                                std::function<void()> lost,
+                                freenect_device** device) {
+    std::lock_guard<std::mutex> openLock(m_openMutex);
+
+    int error;
+    if (serial.empty()) {
+        error = freenect_open_device(m_context, device, index);
+    }
+    else {
+        error = freenect_open_device_by_camera_serial(m_context, device,
+                                                      serial.c_str());
+    }
+    if (error != 0) {
+        return 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_devicesMutex);
+        m_devices.push_back({*device, std::move(lost)});
+    }
+
+    if (!m_eventsRunning) {
+        // An event thread that failed has exited, but still needs joining
+        if (m_eventThread.joinable()) {
+            m_eventThread.join();
+        }
+
+        m_eventsRunning = true;
+        m_eventThread = std::thread(&FreenectContext::eventMain, this);
+    }
+
+    return 0;
+}
+
+void FreenectContext::closeDevice(freenect_device* device) {
+    std::lock_guard<std::mutex> openLock(m_openMutex);
+
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(m_devicesMutex);
+        m_devices.erase(std::remove_if(m_devices.begin(), m_devices.end(),
+            [device](const Device& open) {
+                return open.device == device;
+            }), m_devices.end());
+        last = m_devices.empty();
+    }
+
+    freenect_close_device(device);
+
+    if (last) {
+        m_eventsRunning = false;
+        if (m_eventThread.joinable()) {
+            m_eventThread.join();
+        }
+    }
+}
+
+void FreenectContext::eventMain() {
+    timeval timeout = {0, FREENECT_EVENT_TIMEOUT_US};
+
+    while (m_eventsRunning) {
+        if (freenect_process_events_timeout(m_context, &timeout) < 0) {
+            std::fprintf(stderr, "libfreenect stopped handling events\n");
+            break;
+        }
+    }
+
+    if (!m_eventsRunning) {
+        return;
+    }
+
+    m_eventsRunning = false;
+
+    // Tell every device still open that it won't get any more frames
+    std::vector<std::function<void()>> lost;
+    {
+        std::lock_guard<std::mutex> lock(m_devicesMutex);
+        for (const auto& open : m_devices) {
+            lost.push_back(open.lost);
+        }
+    }
+
+    for (const auto& callback : lost) {
+        if (callback != nullptr) {
+            callback();
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/* One libfreenect context shared by every Kinect in the process. It owns the
+   thread that handles USB events, so several devices can stream at once
+   without each needing a context and event loop of its own. */
+
+#ifndef FREENECT_CONTEXT_HPP
+#define FREENECT_CONTEXT_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libfreenect/libfreenect.h>
+
+// Longest the event thread waits for USB events before checking for shutdown
+#define FREENECT_EVENT_TIMEOUT_US 10000
+
+/* Devices are opened and closed through the context. The event thread is
+ * started when the first device is opened and stopped when the last one is
+ * closed; the video and depth callbacks of every device run on it.
+ */
+class FreenectContext {
+public:
+    ~FreenectContext();
+
+    FreenectContext(const FreenectContext&) = delete;
+    FreenectContext& operator=(const FreenectContext&) = delete;
+
+    /* Returns the context, initializing libfreenect if nothing holds it yet.
+     * It's shut down when the last holder lets go. Returns nullptr if
+     * libfreenect couldn't be initialized.
+     */
+    static std::shared_ptr<FreenectContext> get();
+
+    // Returns the number of Kinects connected
+    int deviceCount();
+
+    // Returns the serial numbers of the connected Kinects in index order
+    std::vector<std::string> serials();
+
+    /* Opens the Kinect with the given serial number, or the one at index if
+     * serial is empty. lost is called from the event thread if libfreenect
+     * stops handling events, which means the device is gone. Returns 0 on
+     * success.
+     */
+    int openDevice(int index, const std::string& serial,
+                   std::function<void()> lost, freenect_device** device);
+
+    // Closes a device opened with openDevice(); its streams must be stopped
+    void closeDevice(freenect_device* device);
+
+private:
+    class Device {
+    public:
+        freenect_device* device;
+        std::function<void()> lost;
+    };
+
+    explicit FreenectContext(freenect_context* context);
+
+    freenect_context* m_context;
+
+    // Serializes opening and closing devices, and with it the event thread
+    std::mutex m_openMutex;
+
+    // Protects m_devices, which the event thread reads if it fails
+    std::mutex m_devicesMutex;
+    std::vector<Device> m_devices;
+
+    std::thread m_eventThread;
+    std::atomic<bool> m_eventsRunning{false};
+
+    void eventMain();
+};
+
+#endif // FREENECT_CONTEXT_HPP
@@ -0,0 +1,115 @@
+/* Perspective transform from the screen as the Kinect sees it to screen
+   coordinates. Computed once when the screen is found, so mapping a point
+   costs a few multiply-adds and a division. */
+
+#include <cmath>
+#include <utility>
+
+#include "Homography.hpp"
+
+bool Homography::build(const CvPoint corners[4]) {
+    CvPoint2D32f points[4];
+    for (int i = 0; i < 4; i++) {
+        points[i] = cvPoint2D32f(corners[i].x, corners[i].y);
+    }
+
+    return build(points);
+}
+
+bool Homography::build(const CvPoint2D32f corners[4]) {
+    // Where each corner goes on the unit square
+    const double dest[4][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}};
+
+    /* Each correspondence (x, y) -> (u, v) gives two equations in the eight
+     * unknowns h0..h7 (h8 is fixed at 1):
+     *   h0 x + h1 y + h2 - h6 x u - h7 y u = u
+     *   h3 x + h4 y + h5 - h6 x v - h7 y v = v
+     */
+    double a[8][9];
+    for (int i = 0; i < 4; i++) {
+        double x = corners[i].x;
+        double y = corners[i].y;
+        double u = dest[i][0];
+        double v = dest[i][1];
+
+        double rowU[9] = {x, y, 1, 0, 0, 0, -x * u, -y * u, u};
+        double rowV[9] = {0, 0, 0, x, y, 1, -x * v, -y * v, v};
+        for (int j = 0; j < 9; j++) {
+            a[2 * i][j] = rowU[j];
+            a[2 * i + 1][j] = rowV[j];
+        }
+    }
+
+    // Gaussian elimination with partial pivoting
+    for (int col = 0; col < 8; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < 8; row++) {
+            if (std::fabs(a[row][col]) > std::fabs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+
+        if (std::fabs(a[pivot][col]) < 1e-9) {
+            m_valid = false;
+            return false;
+        }
+
+        if (pivot != col) {
+            for (int j = 0; j < 9; j++) {
+                std::swap(a[pivot][j], a[col][j]);
+            }
+        }
+
+        for (int row = 0; row < 8; row++) {
+            if (row == col) {
+                continue;
+            }
+
+            double factor = a[row][col] / a[col][col];
+            for (int j = col; j < 9; j++) {
+                a[row][j] -= factor * a[col][j];
+            }
+        }
+    }
+
+    for (int i = 0; i < 8; i++) {
+        m_m[i] = static_cast<float>(a[i][8] / a[i][i]);
+    }
+    m_m[8] = 1.f;
+
+    m_valid = true;
+    return true;
+}
+
+bool Homography::isValid() const {
+    return m_valid;
+}
+
+CvPoint2D32f Homography::map(CvPoint2D32f point) const {
+    float w = m_m[6] * point.x + m_m[7] * point.y + m_m[8];
+
+    return cvPoint2D32f((m_m[0] * point.x + m_m[1] * point.y + m_m[2]) / w,
+                        (m_m[3] * point.x + m_m[4] * point.y + m_m[5]) / w);
+}
+
+void Homography::map(const CvPoint* in, CvPoint* out, unsigned int count,
+                     int width, int height) const {
+    // Fold the scale to the output rectangle into the first two rows
+    const float m0 = m_m[0] * width;
+    const float m1 = m_m[1] * width;
+    const float m2 = m_m[2] * width;
+    const float m3 = m_m[3] * height;
+    const float m4 = m_m[4] * height;
+    const float m5 = m_m[5] * height;
+
+    for (unsigned int i = 0; i < count; i++) {
+        float x = in[i].x;
+        float y = in[i].y;
+        float w = m_m[6] * x + m_m[7] * y + m_m[8];
+
+        out[i].x = static_cast<int>(std::floor((m0 * x + m1 * y + m2) / w +
+                                               0.5f));
+        out[i].y = static_cast<int>(std::floor((m3 * x + m4 * y + m5) / w +
+                                               0.5f));
+    }
+}
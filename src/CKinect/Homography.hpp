@@ -0,0 +1,46 @@
+/* Perspective transform from the screen as the Kinect sees it to screen
+   coordinates. Computed once when the screen is found, so mapping a point
+   costs a few multiply-adds and a division. */
+
+#ifndef HOMOGRAPHY_HPP
+#define HOMOGRAPHY_HPP
+
+#include <opencv2/core/core_c.h>
+
+/* Maps points in the image onto the unit square, with the image's view of the
+ * screen's top left corner at (0, 0) and its bottom right corner at (1, 1).
+ * Unlike scaling by the distances to the quadrilateral's edges, this is exact
+ * for any view of a flat screen, including keystoned ones.
+ */
+class Homography {
+public:
+    /* Computes the transform taking corners, in the order sortquad() leaves
+     * them (top left, bottom left, bottom right, top right), to the corners of
+     * the unit square. Returns false and leaves the transform invalid if three
+     * of the corners are collinear.
+     */
+    bool build(const CvPoint corners[4]);
+
+    // Same as above, for corners known to a fraction of a pixel
+    bool build(const CvPoint2D32f corners[4]);
+
+    bool isValid() const;
+
+    // Maps a single point onto the unit square
+    CvPoint2D32f map(CvPoint2D32f point) const;
+
+    /* Maps count points onto a width by height rectangle, rounding to the
+     * nearest pixel. in and out may be the same array.
+     */
+    void map(const CvPoint* in, CvPoint* out, unsigned int count, int width,
+             int height) const;
+
+private:
+    // Row-major 3x3 matrix, normalized so m[8] is 1
+    float m_m[9] = {1.f, 0.f, 0.f,
+                    0.f, 1.f, 0.f,
+                    0.f, 0.f, 1.f};
+    bool m_valid = false;
+};
+
+#endif // HOMOGRAPHY_HPP
@@ -0,0 +1,114 @@
+/* Lock-free log-linear histogram of latencies, in the style of an HDR
+   histogram. Recording is a single relaxed atomic increment, so it can be
+   done from any thread on every frame. */
+
+#include "LatencyHistogram.hpp"
+
+#include <chrono>
+
+uint64_t latencyClock() {
+    using namespace std::chrono;
+
+    return duration_cast<nanoseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    m_buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (ns > max && !m_max.compare_exchange_weak(max, ns,
+                                                    std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::recordSince(uint64_t start) {
+    uint64_t now = latencyClock();
+
+    // Frames without a capture time (0) would skew the results
+    if (start != 0 && now >= start) {
+        record(now - start);
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    // Rank of the value wanted, counting from 1
+    uint64_t rank = fraction * total + 0.5;
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > total) {
+        rank = total;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < bucketCount; i++) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // Never report more than the largest value actually seen
+            uint64_t bound = bucketUpperBound(i);
+            uint64_t max = m_max.load(std::memory_order_relaxed);
+            return bound < max ? bound : max;
+        }
+    }
+
+    return m_max.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return m_count.load(std::memory_order_relaxed);
+}
+
+LatencySummary LatencyHistogram::summary() const {
+    LatencySummary summary;
+
+    summary.count = count();
+    summary.p50 = percentile(0.5);
+    summary.p99 = percentile(0.99);
+    summary.p999 = percentile(0.999);
+    summary.max = m_max.load(std::memory_order_relaxed);
+
+    return summary;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+unsigned int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < subBuckets) {
+        return value;
+    }
+
+    // Position of the highest set bit (at least subBits here)
+    unsigned int exponent = 63 - __builtin_clzll(value);
+    unsigned int shift = exponent - subBits;
+
+    // The top subBits + 1 bits select the bucket within this power of two
+    return (shift + 1) * subBuckets + ((value >> shift) - subBuckets);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(unsigned int index) {
+    if (index < subBuckets) {
+        return index;
+    }
+
+    unsigned int shift = index / subBuckets - 1;
+    uint64_t sub = index % subBuckets + subBuckets;
+
+    return ((sub + 1) << shift) - 1;
+}
@@ -0,0 +1,68 @@
+/* Lock-free log-linear histogram of latencies, in the style of an HDR
+   histogram. Recording is a single relaxed atomic increment, so it can be
+   done from any thread on every frame. */
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Returns a monotonic timestamp in nanoseconds for measuring latencies
+uint64_t latencyClock();
+
+class LatencySummary {
+public:
+    uint64_t count = 0;
+
+    // All in nanoseconds
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+/* Values below 16 ns are counted exactly. Above that, every power of two is
+ * split into 16 linear buckets, so any recorded value is known to within
+ * 1/16 (about 6%).
+ */
+class LatencyHistogram {
+public:
+    static const unsigned int subBuckets = 16;
+    static const unsigned int subBits = 4;
+    static const unsigned int bucketCount = (64 - subBits + 1) * subBuckets;
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t ns);
+
+    // Records the time elapsed since start (a value from latencyClock())
+    void recordSince(uint64_t start);
+
+    /* Returns the smallest value that at least the given fraction of the
+     * recorded values don't exceed (rounded up to its bucket's upper bound)
+     */
+    uint64_t percentile(double fraction) const;
+
+    uint64_t count() const;
+
+    LatencySummary summary() const;
+
+    // Not atomic with respect to concurrent record() calls
+    void reset();
+
+private:
+    std::atomic<uint64_t> m_buckets[bucketCount];
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_max{0};
+
+    static unsigned int bucketIndex(uint64_t value);
+
+    // Returns the largest value that falls into the given bucket
+    static uint64_t bucketUpperBound(unsigned int index);
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
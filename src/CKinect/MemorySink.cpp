@@ -0,0 +1,41 @@
+/* Pointer sink that keeps every event it's given in memory instead of
+   injecting it, so the output of a replayed session can be checked */
+
+#include "MemorySink.hpp"
+
+int MemorySink::submit(const PointerEvent* events, unsigned int count) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_events.insert(m_events.end(), events, events + count);
+        m_batchSizes.push_back(count);
+    }
+
+    m_cond.notify_all();
+
+    return 0;
+}
+
+std::vector<PointerEvent> MemorySink::events() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_events;
+}
+
+std::vector<unsigned int> MemorySink::batchSizes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_batchSizes;
+}
+
+bool MemorySink::waitFor(unsigned int count,
+                         std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_cond.wait_for(lock, timeout, [&] {
+        return m_events.size() >= count;
+    });
+}
+
+void MemorySink::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_events.clear();
+    m_batchSizes.clear();
+}
@@ -0,0 +1,40 @@
+/* Pointer sink that keeps every event it's given in memory instead of
+   injecting it, so the output of a replayed session can be checked */
+
+#ifndef MEMORY_SINK_HPP
+#define MEMORY_SINK_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "PointerSink.hpp"
+
+class MemorySink : public PointerSink {
+public:
+    int submit(const PointerEvent* events, unsigned int count) override;
+
+    // Returns a copy of every event submitted so far, oldest first
+    std::vector<PointerEvent> events() const;
+
+    // Returns the number of events in each batch submitted so far
+    std::vector<unsigned int> batchSizes() const;
+
+    /* Waits until at least count events have been submitted. Returns false
+     * if that doesn't happen within timeout.
+     */
+    bool waitFor(unsigned int count, std::chrono::milliseconds timeout);
+
+    // Forgets everything submitted so far
+    void clear();
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    std::vector<PointerEvent> m_events;
+    std::vector<unsigned int> m_batchSizes;
+};
+
+#endif // MEMORY_SINK_HPP
@@ -6,11 +6,20 @@
 #include <mutex>
 #include <cstdint>
 
+#include "FramePool.hpp"
+#include "TripleBuffer.hpp"
+#include "LatencyHistogram.hpp"
+
 #define NSTREAM_DOWN 0
 #define NSTREAM_UP 1
 #define NSTREAM_STARTING 2
 #define NSTREAM_STOPPING 3
 
+// Buffering modes
+#define NSTREAM_DOUBLE 0 // Two buffers swapped under the mutex
+#define NSTREAM_POOLED 1 // Frames from a FramePool handed out by reference
+#define NSTREAM_TRIPLE 2 // Lock-free triple buffer for a single consumer
+
 template <class T>
 class NStream;
 
@@ -18,7 +27,28 @@ template <class T>
 class NStream {
 public:
     NStream(int width, int height, int depth, int (T::*startstream)(NStream<T>&),
-                     int (T::*stopstream)(), T* ih);
+                     int (T::*stopstream)(), T* ih,
+                     int bufferMode = NSTREAM_DOUBLE,
+                     unsigned int poolFrames = 8);
+
+    // Returns the buffer the producer should fill with the next frame
+    uint8_t* writeBuffer();
+
+    /* Called by the producer once the buffer from writeBuffer() is filled.
+     * Makes it the newest frame and returns true if consumers should be told
+     * about it. A pooled stream drops the frame and returns false if every
+     * other frame in the pool is still held by consumers. A triple-buffered
+     * stream never takes the mutex. captureTime is the latencyClock() time
+     * the frame arrived, which pooled and triple-buffered streams keep with
+     * the frame; 0 means now.
+     */
+    bool commitFrame(uint32_t timestamp, uint64_t captureTime = 0);
+
+    /* Returns a reference to the newest frame of a pooled stream, which stays
+     * valid however long the caller holds it. The frame's contents must be
+     * treated as read-only since other consumers may share it.
+     */
+    FrameRef getFrame();
 
     std::mutex mutex;
 
@@ -40,6 +70,26 @@ public:
     // The current swapped-in buffer
     uint8_t* buf = nullptr;
 
+    // NSTREAM_DOUBLE, NSTREAM_POOLED or NSTREAM_TRIPLE
+    int bufferMode;
+
+    // Frame storage for pooled streams (buf0 and buf1 aren't allocated)
+    std::unique_ptr<FramePool> pool;
+
+    // Newest complete frame of a pooled stream (protected by mutex)
+    FrameRef frame;
+
+    // Frame the producer is currently filling
+    FrameRef fillFrame;
+
+    /* Frame storage for triple-buffered streams. Its single consumer reads
+     * frames with triple->update() and triple->frontBuffer() instead of buf.
+     */
+    std::unique_ptr<TripleBuffer> triple;
+
+    // Frames dropped because the pool was exhausted
+    std::atomic<unsigned int> droppedFrames{0};
+
     void* callbackarg = nullptr;
 
     void (*streamStarting)(NStream<T>&, void*) = nullptr;
@@ -27,23 +27,101 @@
  *     a pointer to an instance of a structure which contains
  *     additional state information about the module implementing the
  *     sending side of NStream.
+ * bufferMode: NSTREAM_DOUBLE swaps between two buffers. NSTREAM_POOLED fills
+ *             frames from a pool of poolFrames buffers and hands them to
+ *             consumers by reference instead of having them copy buf.
+ *             NSTREAM_TRIPLE publishes through a lock-free triple buffer
+ *             so a slow consumer can never stall the producer.
+ * poolFrames: The number of frames in the pool of a pooled stream.
  */
 template <class T>
 NStream<T>::NStream(int width, int height, int depth,
                     int (T::*startStream)(NStream<T>&),
-                    int (T::*stopStream)(), T* ih) {
+                    int (T::*stopStream)(), T* ih, int bufferMode,
+                    unsigned int poolFrames) {
     imgWidth = width;
     imgHeight = height;
     imgDepth = depth;
 
     bufSize = imgWidth * imgHeight * imgDepth;
 
-    buf0 = std::make_unique<uint8_t[]>(bufSize);
-    buf1 = std::make_unique<uint8_t[]>(bufSize);
+    this->bufferMode = bufferMode;
 
-    buf = buf0.get();
+    if (bufferMode == NSTREAM_POOLED) {
+        pool = std::make_unique<FramePool>(bufSize, poolFrames);
+        fillFrame = pool->acquire();
+    }
+    else if (bufferMode == NSTREAM_TRIPLE) {
+        triple = std::make_unique<TripleBuffer>(bufSize);
+    }
+    else {
+        buf0 = std::make_unique<uint8_t[]>(bufSize);
+        buf1 = std::make_unique<uint8_t[]>(bufSize);
+
+        buf = buf0.get();
+    }
 
     this->startStream = startStream;
     this->stopStream = stopStream;
     this->ih = ih;
 }
+
+template <class T>
+uint8_t* NStream<T>::writeBuffer() {
+    if (bufferMode == NSTREAM_POOLED) {
+        return fillFrame.data();
+    }
+    else if (bufferMode == NSTREAM_TRIPLE) {
+        return triple->writeBuffer();
+    }
+    else if (buf == buf0.get()) {
+        return buf1.get();
+    }
+    else {
+        return buf0.get();
+    }
+}
+
+template <class T>
+bool NStream<T>::commitFrame(uint32_t timestamp, uint64_t captureTime) {
+    if (bufferMode == NSTREAM_POOLED) {
+        // Get the next frame to fill before giving up the filled one
+        FrameRef next = pool->acquire();
+        if (!next) {
+            // Consumers hold every frame, so overwrite this one
+            droppedFrames++;
+            return false;
+        }
+
+        fillFrame.setTimestamp(timestamp);
+        fillFrame.setCaptureTime(captureTime != 0 ? captureTime : latencyClock());
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            this->timestamp = timestamp;
+            frame = std::move(fillFrame);
+            buf = frame.data();
+        }
+
+        fillFrame = std::move(next);
+    }
+    else if (bufferMode == NSTREAM_TRIPLE) {
+        triple->publish(timestamp, captureTime != 0 ? captureTime :
+                                                      latencyClock());
+    }
+    else {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        this->timestamp = timestamp;
+        buf = writeBuffer();
+    }
+
+    return true;
+}
+
+template <class T>
+FrameRef NStream<T>::getFrame() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return frame;
+}
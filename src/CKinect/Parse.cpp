@@ -3,9 +3,13 @@
 
 #include <opencv2/imgproc/imgproc_c.h>
 #include <opencv2/highgui/highgui_c.h>
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstring>
 
 #include "Parse.hpp"
+#include "ColorMask.hpp"
 
 /* Determines the quadrant point is in, if the origin is in the center of the
  * quadrilateral specified by quad. This is used by the sortquad function.
@@ -64,25 +68,216 @@ int quad_getquad(Quad& quad, CvPoint point) {
 
 // Re-orders the points in a quadrilateral in a counter-clockwise manner
 void sortquad(Quad& quad_in) {
-    std::list<QuadSort> sortList;
+    QuadSort sortList[4];
 
     // Create the array of structs to be sorted
     for (int i = 0; i < 4; i++) {
-        QuadSort temp{quad_in.point[i], quad_getquad(quad_in, quad_in.point[i]),
-                      0};
-        sortList.push_back(temp);
+        sortList[i] = {quad_in.point[i], quad_getquad(quad_in, quad_in.point[i]),
+                       0};
     }
 
-    // Sort the list
-    sortList.sort([](const QuadSort& arg0, const QuadSort& arg1) {
-        return arg0.quadrant < arg1.quadrant;
-    });
+    /* Sort the array (a stable insertion sort, since it only has four elements
+     * and this runs on every frame)
+     */
+    for (int i = 1; i < 4; i++) {
+        QuadSort temp = sortList[i];
+        int j = i;
+        while (j > 0 && sortList[j - 1].quadrant > temp.quadrant) {
+            sortList[j] = sortList[j - 1];
+            j--;
+        }
+        sortList[j] = temp;
+    }
 
     // Rearrange the input array
-    int i = 0;
-    for (auto& elem : sortList) {
-        quad_in.point[i] = elem.point;
-        i++;
+    for (int i = 0; i < 4; i++) {
+        quad_in.point[i] = sortList[i].point;
+    }
+}
+
+void QuadSpans::build(const Quad& quad, CvSize size) {
+    left.assign(size.height, 0);
+    right.assign(size.height, -1);
+    top = size.height;
+    bottom = -1;
+
+    int minX = size.width;
+    int maxX = -1;
+
+    for (int y = 0; y < size.height; y++) {
+        double xMin = HUGE_VAL;
+        double xMax = -HUGE_VAL;
+
+        // Intersect the row with each edge of the quadrilateral
+        for (int i = 0; i < 4; i++) {
+            CvPoint p0 = quad.point[i];
+            CvPoint p1 = quad.point[(i + 1) % 4];
+
+            if (y < std::min(p0.y, p1.y) || y > std::max(p0.y, p1.y)) {
+                continue;
+            }
+
+            if (p0.y == p1.y) {
+                // Horizontal edge on this row
+                xMin = std::min(xMin, static_cast<double>(std::min(p0.x, p1.x)));
+                xMax = std::max(xMax, static_cast<double>(std::max(p0.x, p1.x)));
+            }
+            else {
+                double x = p0.x + static_cast<double>(y - p0.y) *
+                           (p1.x - p0.x) / (p1.y - p0.y);
+                xMin = std::min(xMin, x);
+                xMax = std::max(xMax, x);
+            }
+        }
+
+        if (xMin > xMax) {
+            continue;
+        }
+
+        int x0 = std::max(0, static_cast<int>(std::ceil(xMin)));
+        int x1 = std::min(size.width - 1, static_cast<int>(std::floor(xMax)));
+        if (x0 > x1) {
+            continue;
+        }
+
+        left[y] = x0;
+        right[y] = x1;
+        top = std::min(top, y);
+        bottom = std::max(bottom, y);
+        minX = std::min(minX, x0);
+        maxX = std::max(maxX, x1);
+    }
+
+    if (empty()) {
+        bounds = cvRect(0, 0, 0, 0);
+    }
+    else {
+        bounds = cvRect(minX, top, maxX - minX + 1, bottom - top + 1);
+    }
+}
+
+void QuadSpans::clip(CvRect window, QuadSpans& out) const {
+    out.left.resize(left.size());
+    out.right.resize(right.size());
+    out.top = static_cast<int>(left.size());
+    out.bottom = -1;
+
+    int minX = window.x + window.width;
+    int maxX = -1;
+
+    int y0 = std::max(top, window.y);
+    int y1 = std::min(bottom, window.y + window.height - 1);
+    for (int y = y0; y <= y1; y++) {
+        int x0 = std::max(left[y], window.x);
+        int x1 = std::min(right[y], window.x + window.width - 1);
+
+        out.left[y] = x0;
+        out.right[y] = x1;
+
+        if (x0 > x1) {
+            continue;
+        }
+
+        out.top = std::min(out.top, y);
+        out.bottom = y;
+        minX = std::min(minX, x0);
+        maxX = std::max(maxX, x1);
+    }
+
+    if (out.empty()) {
+        out.bounds = cvRect(0, 0, 0, 0);
+    }
+    else {
+        out.bounds = cvRect(minX, out.top, maxX - minX + 1,
+                            out.bottom - out.top + 1);
+    }
+}
+
+void QuadSpans::decimate(int step, QuadSpans& out) const {
+    int rows = (static_cast<int>(left.size()) + step - 1) / step;
+
+    out.left.resize(rows);
+    out.right.resize(rows);
+    out.top = rows;
+    out.bottom = -1;
+
+    int minX = INT_MAX;
+    int maxX = -1;
+
+    if (!empty()) {
+        for (int y = (top + step - 1) / step; y * step <= bottom; y++) {
+            int x0 = left[y * step];
+            int x1 = right[y * step];
+
+            // Columns of the grid points inside the span
+            if (x0 <= x1) {
+                x0 = (x0 + step - 1) / step;
+                x1 /= step;
+            }
+
+            out.left[y] = x0;
+            out.right[y] = x1;
+
+            if (x0 > x1) {
+                continue;
+            }
+
+            out.top = std::min(out.top, y);
+            out.bottom = y;
+            minX = std::min(minX, x0);
+            maxX = std::max(maxX, x1);
+        }
+    }
+
+    if (out.empty()) {
+        out.bounds = cvRect(0, 0, 0, 0);
+    }
+    else {
+        out.bounds = cvRect(minX, out.top, maxX - minX + 1,
+                            out.bottom - out.top + 1);
+    }
+}
+
+FilterWorkspace::FilterWorkspace() {
+    std::memset(&frameHeader, 0, sizeof(frameHeader));
+}
+
+FilterWorkspace::~FilterWorkspace() {
+    if (mask != nullptr) {
+        cvReleaseImage(&mask);
+    }
+    if (storage != nullptr) {
+        cvReleaseMemStorage(&storage);
+    }
+    if (coarseMask != nullptr) {
+        cvReleaseImage(&coarseMask);
+    }
+}
+
+void FilterWorkspace::resize(CvSize size) {
+    if (mask != nullptr && (mask->width != size.width ||
+                            mask->height != size.height)) {
+        cvReleaseImage(&mask);
+    }
+    if (mask == nullptr) {
+        mask = cvCreateImage(size, 8, 1);
+    }
+
+    if (storage == nullptr) {
+        storage = cvCreateMemStorage(0);
+    }
+}
+
+void FilterWorkspace::resizeCoarse(CvSize size, int step) {
+    CvSize coarse = cvSize((size.width + step - 1) / step,
+                           (size.height + step - 1) / step);
+
+    if (coarseMask != nullptr && (coarseMask->width != coarse.width ||
+                                  coarseMask->height != coarse.height)) {
+        cvReleaseImage(&coarseMask);
+    }
+    if (coarseMask == nullptr) {
+        coarseMask = cvCreateImage(coarse, 8, 1);
     }
 }
 
@@ -95,42 +290,127 @@ void sortquad(Quad& quad_in) {
 */
 
 int imageFilter(IplImage* image, IplImage** product, int channel) {
-        IplImage *hsvimage;
-        IplImage *tmp0;
-        IplImage *tmp1;
-
-        tmp0 = cvCreateImage(cvGetSize(image), 8, 1);
-        tmp1 = cvCreateImage(cvGetSize(image), 8, 1);
-
-        hsvimage = cvCreateImage(cvGetSize(image), 8, 3);
-        cvCvtColor(image, hsvimage, CV_RGB2HSV);
-
-        switch(channel){
-        case FLT_RED:
-            cvInRangeS(hsvimage, cvScalar(0, 128, 128, 255),
-                cvScalar(10, 255, 255, 255), tmp1);
-
-            cvInRangeS(hsvimage, cvScalar(150, 128, 128, 255),
-                cvScalar(180, 255, 255, 255), tmp0);
-
-            cvOr(tmp0, tmp1, tmp0, nullptr);
-            break;
-        case FLT_GREEN:
-            cvInRangeS(hsvimage, cvScalar(43, 128, 128, 255),
-                cvScalar(70, 255, 255, 255), tmp0);
-            break;
-        case FLT_BLUE:
-            cvInRangeS(hsvimage, cvScalar(99, 64, 64, 255),
-                cvScalar(133, 255, 255, 255), tmp0);
-
-            break;
+    if (image == nullptr || product == nullptr) {
+        return 1;
+    }
+
+    IplImage* mask = cvCreateImage(cvGetSize(image), 8, 1);
+    if (imageFilter(image, mask, channel) != 0) {
+        cvReleaseImage(&mask);
+        return 1;
+    }
+
+    *product = mask;
+
+    return 0;
+}
+
+/* Same as above, but writes the result into product, which must be a
+ * monochrome image the same size as image
+ */
+int imageFilter(IplImage* image, IplImage* product, int channel) {
+    if (image == nullptr || product == nullptr) {
+        return 1;
+    }
+
+    // make sure they passed a valid value into channel
+    if (!(channel == FLT_RED || channel == FLT_GREEN || channel == FLT_BLUE)) {
+        return 1;
+    }
+
+    /* Classify one row at a time since either image may have padding at the
+     * end of its rows
+     */
+    for (int y = 0; y < image->height; y++) {
+        colorMask(reinterpret_cast<uint8_t*>(image->imageData +
+                                             y * image->widthStep),
+                  reinterpret_cast<uint8_t*>(product->imageData +
+                                             y * product->widthStep),
+                  image->width, channel);
+    }
+
+    return 0;
+}
+
+/* Same as above, but only classifies the pixels inside spans. The rest of
+ * product inside spans.bounds is cleared; outside of it product is left
+ * alone, so only that rectangle of it should be used.
+ */
+int imageFilter(IplImage* image, IplImage* product, int channel,
+                const QuadSpans& spans) {
+    if (image == nullptr || product == nullptr) {
+        return 1;
+    }
+
+    if (!(channel == FLT_RED || channel == FLT_GREEN || channel == FLT_BLUE)) {
+        return 1;
+    }
+
+    const CvRect& bounds = spans.bounds;
+
+    for (int y = spans.top; y <= spans.bottom; y++) {
+        uint8_t* rgb = reinterpret_cast<uint8_t*>(image->imageData +
+                                                  y * image->widthStep);
+        uint8_t* mask = reinterpret_cast<uint8_t*>(product->imageData +
+                                                   y * product->widthStep);
+        int x0 = spans.left[y];
+        int x1 = spans.right[y];
+
+        if (x0 > x1) {
+            std::memset(mask + bounds.x, 0, bounds.width);
+            continue;
         }
 
-        *product = tmp0;
-        cvReleaseImage(&tmp1);
-        cvReleaseImage(&hsvimage);
+        // Clear the parts of the bounding rectangle outside the span
+        std::memset(mask + bounds.x, 0, x0 - bounds.x);
+        std::memset(mask + x1 + 1, 0, bounds.x + bounds.width - (x1 + 1));
 
-        return 0;
+        colorMask(rgb + 3 * x0, mask + x0, x1 - x0 + 1, channel);
+    }
+
+    return 0;
+}
+
+/* Same as above, but only classifies the pixel at every step'th column of
+ * every step'th row, and writes the result to a mask decimated by step (see
+ * FilterWorkspace::resizeCoarse()). coarseSpans must come from
+ * QuadSpans::decimate() with the same step. The color test and the
+ * decimation happen in the same pass, so the full-size image is never
+ * filtered or copied.
+ */
+int imageFilterDecimated(IplImage* image, IplImage* product, int channel,
+                         const QuadSpans& coarseSpans, int step) {
+    if (image == nullptr || product == nullptr || step < 1) {
+        return 1;
+    }
+
+    if (!(channel == FLT_RED || channel == FLT_GREEN || channel == FLT_BLUE)) {
+        return 1;
+    }
+
+    const CvRect& bounds = coarseSpans.bounds;
+
+    for (int y = coarseSpans.top; y <= coarseSpans.bottom; y++) {
+        uint8_t* rgb = reinterpret_cast<uint8_t*>(image->imageData +
+                                                  y * step * image->widthStep);
+        uint8_t* mask = reinterpret_cast<uint8_t*>(product->imageData +
+                                                   y * product->widthStep);
+        int x0 = coarseSpans.left[y];
+        int x1 = coarseSpans.right[y];
+
+        if (x0 > x1) {
+            std::memset(mask + bounds.x, 0, bounds.width);
+            continue;
+        }
+
+        std::memset(mask + bounds.x, 0, x0 - bounds.x);
+        std::memset(mask + x1 + 1, 0, bounds.x + bounds.width - (x1 + 1));
+
+        colorMaskStrided(rgb + 3 * step * x0, mask + x0, x1 - x0 + 1, step,
+                         channel);
+    }
+
+    return 0;
 }
 
 #if 0
@@ -389,6 +669,57 @@ int quadCheckPoint(CvPoint point, Quad& quad) {
     return 0;
 }
 
+/* Scales a point inside the quadrilateral quad (representing the screen) to
+ * the screen resolution specified by screenwidth and screenheight. quad must
+ * already be sorted with sortquad(). Returns false if the point is outside of
+ * the quadrilateral.
+ */
+static bool mapToScreen(CvPoint point, Quad& quad, int screenwidth,
+                        int screenheight, CvPoint& out) {
+    int x;
+    int y;
+    int xoffset;
+    int yoffset;
+
+    int x_length;
+    int y_length;
+
+    // is the point within the quadrilateral?
+    if (quadCheckPoint(point, quad)) {
+        // it's outside the quadrilateral
+        return false;
+    }
+
+    /* plist->data is the point inside quadrilateral which we need to
+     * transform into the screen
+     */
+    x = point.x;
+    y = point.y;
+
+    /* find the distance from the origin to the corresponding points on the
+     * side of the quadrilateral
+     */
+    xoffset = interpolateX(quad.point[0], quad.point[1], y);
+    yoffset = interpolateY(quad.point[0], quad.point[3], x);
+
+    // apply the offsets (distance to side of quadrilateral) to the point
+    x -= xoffset;
+    y -= yoffset;
+
+    // ...using the distance formula
+    y_length = hypot(quad.point[1].y - quad.point[0].y,
+        quad.point[1].x - quad.point[0].x);
+    x_length = hypot(quad.point[1].y - quad.point[2].y,
+        quad.point[1].x - quad.point[2].x);
+
+    // proportion the screen dimensions to the quadrilateral dimensions
+    // (x):(quad width) == (x):(screen width)
+    out.x = (x * screenwidth) / x_length;
+    out.y = (y * screenheight) / y_length;
+
+    return true;
+}
+
 /* Takes a list of points from findImageLocation, scales them from the
  * quadrilateral quad (representing the screen), to the screen resolution
  * specified by screenwidth and screenheight. Remember to plist_free(*plist_out)
@@ -404,111 +735,337 @@ std::list<CvPoint> findScreenLocation(std::list<CvPoint>& plist_in,
                                       Quad& quad,
                                       int screenwidth,
                                       int screenheight) {
-    int x;
-    int y;
-    int xoffset;
-    int yoffset;
-
-    int x_length;
-    int y_length;
-    int scrx;
-    int scry;
-
     std::list<CvPoint> plist_out;
+    CvPoint scr;
 
     // Sort the calibration quadrilateral's points counter-clockwise
     sortquad(quad);
 
     for (auto& point : plist_in) {
-        // is the point within the quadrilateral?
-        if (quadCheckPoint(point, quad)) {
-            // it's outside the quadrilateral
+        if (!mapToScreen(point, quad, screenwidth, screenheight, scr)) {
             continue;
         }
 
-        /* plist->data is the point inside quadrilateral which we need to
-         * transform into the screen
-         */
-        x = point.x;
-        y = point.y;
-
-        /* find the distance from the origin to the corresponding points on the
-         * side of the quadrilateral
-         */
-        xoffset = interpolateX(quad.point[0], quad.point[1], y);
-        yoffset = interpolateY(quad.point[0], quad.point[3], x);
-
-        // apply the offsets (distance to side of quadrilateral) to the point
-        x -= xoffset;
-        y -= yoffset;
-
-        // ...using the distance formula
-        y_length = hypot(quad.point[1].y - quad.point[0].y,
-            quad.point[1].x - quad.point[0].x);
-        x_length = hypot(quad.point[1].y - quad.point[2].y,
-            quad.point[1].x - quad.point[2].x);
-
-        // proportion the screen dimensions to the quadrilateral dimensions
-        // (x):(quad width) == (x):(screen width)
-        scrx = (x * screenwidth) / x_length;
-        scry = (y * screenheight) / y_length;
-        point.x = scrx;
-        point.y = scry;
+        point = scr;
         if (plist_out.empty()) {
-            plist_out.emplace_back(scrx, scry);
+            plist_out.push_back(scr);
         }
     }
 
     return plist_out;
 }
 
+/* Same as above, but fills plist_out instead of returning a new list. Doesn't
+ * allocate once plist_out has grown to hold a point.
+ */
+void findScreenLocation(const std::vector<CvPoint>& plist_in,
+                        Quad& quad,
+                        int screenwidth,
+                        int screenheight,
+                        std::vector<CvPoint>& plist_out) {
+    CvPoint scr;
+
+    plist_out.clear();
+
+    // Sort the calibration quadrilateral's points counter-clockwise
+    sortquad(quad);
+
+    for (const auto& point : plist_in) {
+        if (!mapToScreen(point, quad, screenwidth, screenheight, scr)) {
+            continue;
+        }
+
+        if (plist_out.empty()) {
+            plist_out.push_back(scr);
+        }
+    }
+}
+
+/* Same as above, but uses the span table and perspective transform built
+ * from the quadrilateral when the screen was found. Every point inside the
+ * screen is mapped, in the order they were given, and all of them are mapped
+ * in one batch.
+ */
+void findScreenLocation(const std::vector<CvPoint>& plist_in,
+                        const Homography& homography,
+                        const QuadSpans& spans,
+                        int screenwidth,
+                        int screenheight,
+                        std::vector<CvPoint>& plist_out) {
+    plist_out.clear();
+
+    for (const auto& point : plist_in) {
+        if (spans.contains(point)) {
+            plist_out.push_back(point);
+        }
+    }
+
+    homography.map(plist_out.data(), plist_out.data(), plist_out.size(),
+                   screenwidth, screenheight);
+}
+
+/* Same as above, but looks points up in a lens-corrected map of the screen.
+ * Whether a point is inside the screen is decided by the map too, so no span
+ * table is needed.
+ */
+void findScreenLocation(const std::vector<CvPoint>& plist_in,
+                        const ScreenMap& screenMap,
+                        int screenwidth,
+                        int screenheight,
+                        std::vector<CvPoint>& plist_out) {
+    plist_out.clear();
+
+    for (const auto& point : plist_in) {
+        if (screenMap.contains(point)) {
+            plist_out.push_back(point);
+        }
+    }
+
+    screenMap.map(plist_out.data(), plist_out.data(), plist_out.size(),
+                  screenwidth, screenheight);
+}
+
 /* Creates a list of points in the image which could be the pointer. Finds areas
  * of color specified by channel. Acceptable values are the same as used by
  * imageFilter(). Remember to plist_free(*plist_out) when you're done with it.
  */
 std::list<CvPoint> findImageLocation(IplImage* image, int channel) {
-    CvPoint point;
-    CvMemStorage* storage;
+    FilterWorkspace workspace;
+    std::vector<CvPoint> points;
+
+    findImageLocation(image, channel, workspace, points);
+
+    return std::list<CvPoint>(points.begin(), points.end());
+}
+
+/* Same as above, but keeps its scratch images and contour storage in
+ * workspace, and fills plist instead of returning a new list. Call this on
+ * every frame with the same workspace and plist to avoid allocating.
+ */
+void findImageLocation(IplImage* image, int channel,
+                       FilterWorkspace& workspace,
+                       std::vector<CvPoint>& plist) {
+    plist.clear();
+
+    if (image == nullptr) {
+        return;
+    }
+
+    workspace.resize(cvGetSize(image));
+
+    // filter the channel
+    if (imageFilter(image, workspace.mask, channel) != 0) {
+        return;
+    }
+
+    // We now have an image with only the channel we want
+    findMaskLocation(workspace.mask, workspace, plist);
+}
+
+/* Finds the blobs in a monochrome mask produced by imageFilter() that are
+ * large enough to be a pointer. If spans is given, only the rectangle bounding
+ * them is scanned. The mask isn't modified.
+ */
+void findMaskBlobs(IplImage* mask, FilterWorkspace& workspace,
+                   std::vector<Blob>& blobs,
+                   const QuadSpans* spans) {
+    blobs.clear();
+
+    if (mask == nullptr) {
+        return;
+    }
+
+    CvRect region = cvRect(0, 0, mask->width, mask->height);
+    if (spans != nullptr) {
+        if (spans->empty()) {
+            return;
+        }
+
+        region = spans->bounds;
+    }
+
+    workspace.labeler.label(reinterpret_cast<uint8_t*>(mask->imageData),
+                            mask->widthStep, region, blobs);
+
+    // Drop the specks too small to be a pointer
+    blobs.erase(std::remove_if(blobs.begin(), blobs.end(),
+        [](const Blob& blob) {
+            return blob.bounds.width <= 4 || blob.bounds.height <= 4;
+        }), blobs.end());
+}
+
+/* Second half of findImageLocation(): finds the centers of the blobs in a
+ * monochrome mask produced by imageFilter(). If spans is given, only the
+ * rectangle bounding them is scanned.
+ */
+void findMaskLocation(IplImage* mask, FilterWorkspace& workspace,
+                      std::vector<CvPoint>& plist,
+                      const QuadSpans* spans) {
+    plist.clear();
+
+    findMaskBlobs(mask, workspace, workspace.blobs, spans);
+
+    for (const auto& blob : workspace.blobs) {
+        plist.emplace_back(static_cast<int>(blob.x + 0.5f),
+                           static_cast<int>(blob.y + 0.5f));
+    }
+}
+
+/* Second half of findImageLocationPyramid(): finds the blobs in the decimated
+ * mask imageFilterDecimated() left in workspace.coarseMask, then finds each
+ * one's center at full resolution by filtering and labeling only a small
+ * window of image around it. Each window is padded by a grid step on every
+ * side so it covers the parts of the blob that fell between samples.
+ */
+void refineMaskLocation(IplImage* image, int channel, int step,
+                        const QuadSpans& spans, FilterWorkspace& workspace,
+                        std::vector<CvPoint>& plist) {
+    plist.clear();
+    workspace.refined.clear();
+
+    if (image == nullptr || workspace.coarseMask == nullptr ||
+            workspace.coarseSpans.empty()) {
+        return;
+    }
+
+    workspace.resize(cvGetSize(image));
+
+    IplImage* coarse = workspace.coarseMask;
+    workspace.labeler.label(reinterpret_cast<uint8_t*>(coarse->imageData),
+                            coarse->widthStep, workspace.coarseSpans.bounds,
+                            workspace.coarseBlobs);
+
+    IplImage* mask = workspace.mask;
+    for (const auto& coarseBlob : workspace.coarseBlobs) {
+        if (coarseBlob.area < PYRAMID_MIN_AREA) {
+            continue;
+        }
+
+        /* A large blob can come apart into several pieces when decimated.
+         * Skip the pieces of one that's already been refined.
+         */
+        CvPoint center = cvPoint(static_cast<int>(coarseBlob.x * step + 0.5f),
+                                 static_cast<int>(coarseBlob.y * step + 0.5f));
+        bool found = false;
+        for (const auto& rect : workspace.refined) {
+            if (center.x >= rect.x && center.x < rect.x + rect.width &&
+                    center.y >= rect.y && center.y < rect.y + rect.height) {
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            continue;
+        }
+
+        const CvRect& bounds = coarseBlob.bounds;
+        spans.clip(cvRect((bounds.x - 1) * step, (bounds.y - 1) * step,
+                          (bounds.width + 1) * step + 1,
+                          (bounds.height + 1) * step + 1),
+                   workspace.patchSpans);
+        if (workspace.patchSpans.empty()) {
+            continue;
+        }
+
+        imageFilter(image, mask, channel, workspace.patchSpans);
+        workspace.labeler.label(reinterpret_cast<uint8_t*>(mask->imageData),
+                                mask->widthStep, workspace.patchSpans.bounds,
+                                workspace.blobs);
+
+        // The biggest blob in the window is the one that was seen decimated
+        const Blob* best = nullptr;
+        for (const auto& blob : workspace.blobs) {
+            if (blob.bounds.width <= 4 || blob.bounds.height <= 4) {
+                continue;
+            }
+            if (best == nullptr || blob.area > best->area) {
+                best = &blob;
+            }
+        }
+
+        if (best != nullptr) {
+            plist.emplace_back(static_cast<int>(best->x + 0.5f),
+                               static_cast<int>(best->y + 0.5f));
+            workspace.refined.push_back(best->bounds);
+        }
+    }
+}
+
+/* Coarse-to-fine version of findImageLocation() for pointers much bigger than
+ * step pixels: candidates are found in the image decimated by step, then
+ * refined at full resolution. Only the pixels inside spans are searched.
+ */
+void findImageLocationPyramid(IplImage* image, int channel, int step,
+                              const QuadSpans& spans,
+                              FilterWorkspace& workspace,
+                              std::vector<CvPoint>& plist) {
+    plist.clear();
+
+    if (image == nullptr) {
+        return;
+    }
+
+    workspace.resizeCoarse(cvGetSize(image), step);
+    spans.decimate(step, workspace.coarseSpans);
+    if (imageFilterDecimated(image, workspace.coarseMask, channel,
+                             workspace.coarseSpans, step) != 0) {
+        return;
+    }
+
+    refineMaskLocation(image, channel, step, spans, workspace, plist);
+}
+
+/* Same as findMaskLocation(), but traces the blobs' contours with OpenCV and
+ * uses the centers of their bounding rectangles. This is how blobs were found
+ * before findMaskBlobs(); it's kept as a reference to compare against. The
+ * mask's contents are destroyed.
+ */
+void findMaskContours(IplImage* mask, FilterWorkspace& workspace,
+                      std::vector<CvPoint>& plist,
+                      const QuadSpans* spans) {
     CvContourScanner scanner;
     CvSeq* ctr;
     CvRect rect;
-    IplImage* tmp1;
-    std::list<CvPoint> plist;
+    CvPoint origin = cvPoint(0, 0);
 
-    if (image == nullptr) {
-        return plist;
+    plist.clear();
+
+    if (mask == nullptr) {
+        return;
     }
 
-    // filter the green channel
-    if (imageFilter(image, &tmp1, channel) != 0) {
-        return plist;
+    if (spans != nullptr) {
+        if (spans->empty()) {
+            return;
+        }
+
+        cvSetImageROI(mask, spans->bounds);
+        origin = cvPoint(spans->bounds.x, spans->bounds.y);
     }
 
-    // We now have an image with only the channel we want
-    storage = cvCreateMemStorage(0);
-    scanner = cvStartFindContours(tmp1, storage, sizeof(CvContour),
-        CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(0, 0));
+    workspace.resize(cvGetSize(mask));
+
+    // Reuse the blocks allocated by the previous frame's contours
+    cvClearMemStorage(workspace.storage);
+
+    scanner = cvStartFindContours(mask, workspace.storage,
+        sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE,
+        cvPoint(0, 0));
 
     while ((ctr = cvFindNextContour(scanner)) != nullptr) {
         // find the center of the bounding rectangle of the contour
         rect = cvBoundingRect(ctr, 0);
         if (rect.width > 4 && rect.height > 4) {
-            plist.emplace_back(rect.x + rect.width / 2, rect.y + rect.height / 2);
+            plist.emplace_back(origin.x + rect.x + rect.width / 2,
+                               origin.y + rect.y + rect.height / 2);
         }
-
-        // find the first point in the contour
-        /*
-        point = *CV_GET_SEQ_ELEM(CvPoint, ctr, 0);
-        */
     }
 
     cvEndFindContours(&scanner);
-    cvClearMemStorage(storage);
-    cvReleaseMemStorage(&storage);
-
-    cvReleaseImage(&tmp1);
 
-    return plist;
+    if (spans != nullptr) {
+        cvResetImageROI(mask);
+    }
 }
 
 /* Converts a raw 24bit RGB image into an OpenCV IplImage. Use
@@ -526,6 +1083,22 @@ IplImage* RGBtoIplImage(uint8_t* rgbimage, int width, int height) {
     return image;
 }
 
+/* Wraps a raw 24bit RGB image in the header owned by workspace without copying
+ * it. The returned image is only valid until the next call with the same
+ * workspace and must not be released.
+ */
+IplImage* RGBtoIplImage(uint8_t* rgbimage, int width, int height,
+                        FilterWorkspace& workspace) {
+    if (rgbimage == nullptr) {
+        return nullptr;
+    }
+
+    cvInitImageHeader(&workspace.frameHeader, cvSize(width, height), 8, 3);
+    cvSetData(&workspace.frameHeader, rgbimage, width * 3);
+
+    return &workspace.frameHeader;
+}
+
 #if 0
 // Example usage
 int main() {
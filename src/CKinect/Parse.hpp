@@ -5,13 +5,22 @@
 #define PARSE_HPP
 
 #include <opencv2/imgproc/imgproc_c.h>
+#include "BlobLabel.hpp"
+#include "Homography.hpp"
+#include "ScreenMap.hpp"
 #include <list>
+#include <vector>
 #include <cstdint>
 
 #define FLT_RED 0x01
 #define FLT_GREEN 0x02
 #define FLT_BLUE 0x03
 
+/* Blobs in a decimated mask with fewer samples than this are taken to be
+ * noise and never refined
+ */
+#define PYRAMID_MIN_AREA 2
+
 class ContourList {
 public:
     int maxuid;
@@ -38,9 +47,100 @@ public:
     int angle;
 };
 
+/* Horizontal extent of a quadrilateral on each row of an image. Built once
+ * when the screen is found, so the per-frame search can skip everything
+ * outside the screen and test points against it with two comparisons.
+ */
+class QuadSpans {
+public:
+    // Builds the table for quad, which must be sorted with sortquad()
+    void build(const Quad& quad, CvSize size);
+
+    /* Stores in out the part of these spans inside window. Only the rows of
+     * the window are written, so reusing out between calls doesn't cost more
+     * than the window's height.
+     */
+    void clip(CvRect window, QuadSpans& out) const;
+
+    /* Stores in out the spans of the points of a grid with the given step
+     * that are inside these ones, indexed by grid row and column. Used with
+     * imageFilterDecimated().
+     */
+    void decimate(int step, QuadSpans& out) const;
+
+    // Returns true if point is inside the quadrilateral
+    bool contains(CvPoint point) const {
+        return point.y >= top && point.y <= bottom &&
+               point.x >= left[point.y] && point.x <= right[point.y];
+    }
+
+    bool empty() const {
+        return top > bottom;
+    }
+
+    // First and last rows the quadrilateral covers
+    int top = 0;
+    int bottom = -1;
+
+    // Columns covered on each row of the image (left > right if none)
+    std::vector<int> left;
+    std::vector<int> right;
+
+    // Bounding rectangle of all the spans
+    CvRect bounds = {0, 0, 0, 0};
+};
+
+/* Scratch storage kept alive between frames by the caller so the per-frame
+ * detection path doesn't allocate. Everything is created on first use and only
+ * recreated if the image size changes.
+ */
+class FilterWorkspace {
+public:
+    FilterWorkspace();
+    ~FilterWorkspace();
+
+    FilterWorkspace(const FilterWorkspace&) = delete;
+    FilterWorkspace& operator=(const FilterWorkspace&) = delete;
+
+    // Makes sure the scratch images match the given image size
+    void resize(CvSize size);
+
+    /* Makes sure coarseMask can hold an image of the given size decimated by
+     * step
+     */
+    void resizeCoarse(CvSize size, int step);
+
+    // Monochrome output of imageFilter()
+    IplImage* mask = nullptr;
+
+    // Contour storage for findMaskContours()
+    CvMemStorage* storage = nullptr;
+
+    // Labeling scratch and results for findMaskLocation()
+    BlobLabeler labeler;
+    std::vector<Blob> blobs;
+
+    // Decimated mask and screen spans for coarse-to-fine detection
+    IplImage* coarseMask = nullptr;
+    QuadSpans coarseSpans;
+    std::vector<Blob> coarseBlobs;
+
+    // Search window around each coarse blob, and the blobs refined so far
+    QuadSpans patchSpans;
+    std::vector<CvRect> refined;
+
+    // Wraps raw RGB frames without copying them (see RGBtoIplImage())
+    IplImage frameHeader;
+};
+
 int quad_getquad(Quad& quad, CvPoint point);
 void sortquad(Quad& quad_in);
 int imageFilter(IplImage* image, IplImage** product, int channel);
+int imageFilter(IplImage* image, IplImage* product, int channel);
+int imageFilter(IplImage* image, IplImage* product, int channel,
+                const QuadSpans& spans);
+int imageFilterDecimated(IplImage* image, IplImage* product, int channel,
+                         const QuadSpans& coarseSpans, int step);
 Quad findScreenBox(IplImage* redimage,
                    IplImage* greenimage,
                    IplImage* blueimage);
@@ -51,8 +151,45 @@ std::list<CvPoint> findScreenLocation(std::list<CvPoint>& plist_in,
                                       Quad& quad,
                                       int screenwidth,
                                       int screenheight);
+void findScreenLocation(const std::vector<CvPoint>& plist_in,
+                        Quad& quad,
+                        int screenwidth,
+                        int screenheight,
+                        std::vector<CvPoint>& plist_out);
+void findScreenLocation(const std::vector<CvPoint>& plist_in,
+                        const Homography& homography,
+                        const QuadSpans& spans,
+                        int screenwidth,
+                        int screenheight,
+                        std::vector<CvPoint>& plist_out);
+void findScreenLocation(const std::vector<CvPoint>& plist_in,
+                        const ScreenMap& screenMap,
+                        int screenwidth,
+                        int screenheight,
+                        std::vector<CvPoint>& plist_out);
 std::list<CvPoint> findImageLocation(IplImage* image, int channel);
+void findImageLocation(IplImage* image, int channel,
+                       FilterWorkspace& workspace,
+                       std::vector<CvPoint>& plist);
+void findMaskBlobs(IplImage* mask, FilterWorkspace& workspace,
+                   std::vector<Blob>& blobs,
+                   const QuadSpans* spans = nullptr);
+void findMaskLocation(IplImage* mask, FilterWorkspace& workspace,
+                      std::vector<CvPoint>& plist,
+                      const QuadSpans* spans = nullptr);
+void refineMaskLocation(IplImage* image, int channel, int step,
+                        const QuadSpans& spans, FilterWorkspace& workspace,
+                        std::vector<CvPoint>& plist);
+void findImageLocationPyramid(IplImage* image, int channel, int step,
+                              const QuadSpans& spans,
+                              FilterWorkspace& workspace,
+                              std::vector<CvPoint>& plist);
+void findMaskContours(IplImage* mask, FilterWorkspace& workspace,
+                      std::vector<CvPoint>& plist,
+                      const QuadSpans* spans = nullptr);
 IplImage* RGBtoIplImage(uint8_t* rgbimage, int width, int height);
+IplImage* RGBtoIplImage(uint8_t* rgbimage, int width, int height,
+                        FilterWorkspace& workspace);
 void saveRGBimage(IplImage* image, char* path);
 
 #endif // PARSE_HPP
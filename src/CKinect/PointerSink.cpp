@@ -0,0 +1,84 @@
+/* Where the output stage sends the pointers found by tracking. Events are
+   handed over in batches, so a backend can inject a whole batch at once, and
+   moves that newer events make pointless are dropped before they get there. */
+
+#include "PointerSink.hpp"
+
+// Returns true if no pointer in event went down or up
+static bool onlyMoves(const PointerEvent& event) {
+    for (unsigned int i = 0; i < event.contactCount; i++) {
+        if (event.contacts[i].state != CONTACT_MOVE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if next gives a newer position for everything event does
+static bool supersedes(const PointerEvent& next, const PointerEvent& event) {
+    if (event.pointer && !next.pointer) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < event.contactCount; i++) {
+        bool found = false;
+        for (unsigned int j = 0; j < next.contactCount && !found; j++) {
+            found = next.contacts[j].id == event.contacts[i].id;
+        }
+
+        if (!found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if event leaves everything where last put it
+static bool unchanged(const PointerEvent& event, const PointerEvent& last) {
+    if (event.pointer != last.pointer ||
+            (event.pointer && (event.x != last.x || event.y != last.y))) {
+        return false;
+    }
+
+    if (event.contactCount != last.contactCount) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < event.contactCount; i++) {
+        const Contact& a = event.contacts[i];
+        const Contact& b = last.contacts[i];
+
+        if (a.id != b.id || a.point.x != b.point.x || a.point.y != b.point.y) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void coalescePointerEvents(std::vector<PointerEvent>& batch,
+                           const PointerEvent* last) {
+    const PointerEvent* previous = last;
+    unsigned int kept = 0;
+
+    for (unsigned int i = 0; i < batch.size(); i++) {
+        if (onlyMoves(batch[i])) {
+            if (i + 1 < batch.size() && supersedes(batch[i + 1], batch[i])) {
+                continue;
+            }
+            if (previous != nullptr && unchanged(batch[i], *previous)) {
+                continue;
+            }
+        }
+
+        if (kept != i) {
+            batch[kept] = batch[i];
+        }
+        previous = &batch[kept];
+        kept++;
+    }
+
+    batch.resize(kept);
+}
@@ -0,0 +1,59 @@
+/* Where the output stage sends the pointers found by tracking. Events are
+   handed over in batches, so a backend can inject a whole batch at once, and
+   moves that newer events make pointless are dropped before they get there. */
+
+#ifndef POINTER_SINK_HPP
+#define POINTER_SINK_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "ContactTracker.hpp"
+
+// Pointer positions are absolute, from 0 to POINTER_RANGE along each axis
+#define POINTER_RANGE 65535
+
+// Pointers found in one frame
+class PointerEvent {
+public:
+    /* Position in [0, POINTER_RANGE] of the pointer the mouse follows. Only
+     * valid if pointer is true.
+     */
+    uint32_t x = 0;
+    uint32_t y = 0;
+    bool pointer = false;
+
+    /* Every pointer seen in the frame and every one just lost, with points in
+     * the same coordinates as x and y
+     */
+    unsigned int contactCount = 0;
+    Contact contacts[CONTACT_MAX];
+
+    // Timestamp of the frame the pointer was found in
+    uint32_t timestamp = 0;
+
+    // latencyClock() times the frame arrived and the position was found
+    uint64_t captureTime = 0;
+    uint64_t mappedTime = 0;
+};
+
+class PointerSink {
+public:
+    virtual ~PointerSink() = default;
+
+    /* Injects count events, oldest first. It's only called from one thread at
+     * a time, but may take as long as it needs; events found meanwhile are
+     * queued and coalesced. Returns 0 on success and 1 on failure.
+     */
+    virtual int submit(const PointerEvent* events, unsigned int count) = 0;
+};
+
+/* Removes the events in batch that only move pointers, if the next event in
+ * the batch reports all of the same pointers or if nothing moved since the
+ * event before it. last is the newest event submitted before batch, or
+ * nullptr. Events where a pointer goes down or up are always kept.
+ */
+void coalescePointerEvents(std::vector<PointerEvent>& batch,
+                           const PointerEvent* last);
+
+#endif // POINTER_SINK_HPP
@@ -0,0 +1,131 @@
+/* Follows a single pointer from frame to frame with a constant-velocity
+   (alpha-beta) filter, so detection can search a small window around where
+   the pointer is expected instead of the whole screen. */
+
+#include <algorithm>
+#include <cmath>
+
+#include "PointerTracker.hpp"
+
+PointerTracker::PointerTracker(float alpha, float beta) :
+        m_alpha(alpha),
+        m_beta(beta) {
+}
+
+bool PointerTracker::isTracking() const {
+    return m_tracking;
+}
+
+CvRect PointerTracker::predict(uint64_t time, CvSize imageSize) const {
+    float dt = elapsed(time);
+    CvPoint2D32f center = position(time);
+    int x = static_cast<int>(center.x);
+    int y = static_cast<int>(center.y);
+
+    /* Leave room for the pointer being off by the distance it moves in one
+     * interval, and double the window on every frame it was missed
+     */
+    int halfWidth = (TRACKER_WINDOW + static_cast<int>(std::fabs(m_vx * dt)))
+                    << m_misses;
+    int halfHeight = (TRACKER_WINDOW + static_cast<int>(std::fabs(m_vy * dt)))
+                     << m_misses;
+
+    int x0 = std::max(0, x - halfWidth);
+    int y0 = std::max(0, y - halfHeight);
+    int x1 = std::min(imageSize.width, x + halfWidth + 1);
+    int y1 = std::min(imageSize.height, y + halfHeight + 1);
+
+    if (x0 >= x1 || y0 >= y1) {
+        return cvRect(0, 0, 0, 0);
+    }
+
+    return cvRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+CvPoint2D32f PointerTracker::position(uint64_t time) const {
+    float dt = elapsed(time);
+
+    return cvPoint2D32f(m_x + m_vx * dt, m_y + m_vy * dt);
+}
+
+int PointerTracker::closest(const std::vector<CvPoint>& points,
+                            uint64_t time) const {
+    if (points.empty()) {
+        return -1;
+    }
+
+    if (!m_tracking) {
+        return 0;
+    }
+
+    CvPoint2D32f predicted = position(time);
+
+    int best = 0;
+    float bestDist = HUGE_VALF;
+    for (unsigned int i = 0; i < points.size(); i++) {
+        float dx = points[i].x - predicted.x;
+        float dy = points[i].y - predicted.y;
+        float dist = dx * dx + dy * dy;
+
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+void PointerTracker::update(CvPoint point, uint64_t time) {
+    if (!m_tracking) {
+        // Start from rest at the first position seen
+        m_x = point.x;
+        m_y = point.y;
+        m_vx = 0.f;
+        m_vy = 0.f;
+        m_time = time;
+        m_misses = 0;
+        m_tracking = true;
+        return;
+    }
+
+    float dt = elapsed(time);
+
+    // Predict, then correct by a fraction of the residual
+    float x = m_x + m_vx * dt;
+    float y = m_y + m_vy * dt;
+    float rx = point.x - x;
+    float ry = point.y - y;
+
+    m_x = x + m_alpha * rx;
+    m_y = y + m_alpha * ry;
+    m_vx += m_beta * rx / dt;
+    m_vy += m_beta * ry / dt;
+
+    m_time = time;
+    m_misses = 0;
+}
+
+void PointerTracker::miss() {
+    m_misses++;
+
+    if (m_misses > TRACKER_MAX_MISSES) {
+        reset();
+    }
+}
+
+void PointerTracker::reset() {
+    m_tracking = false;
+    m_misses = 0;
+    m_vx = 0.f;
+    m_vy = 0.f;
+}
+
+float PointerTracker::elapsed(uint64_t time) const {
+    // Without capture times, assume consecutive frames at the full rate
+    if (time == 0 || m_time == 0 || time <= m_time) {
+        return TRACKER_DEFAULT_DT / 1e9f;
+    }
+
+    return (time - m_time) / 1e9f;
+}
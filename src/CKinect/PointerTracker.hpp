@@ -0,0 +1,79 @@
+/* Follows a single pointer from frame to frame with a constant-velocity
+   (alpha-beta) filter, so detection can search a small window around where
+   the pointer is expected instead of the whole screen. */
+
+#ifndef POINTER_TRACKER_HPP
+#define POINTER_TRACKER_HPP
+
+#include <opencv2/core/core_c.h>
+#include <cstdint>
+#include <vector>
+
+// Half the width of the search window when the pointer isn't moving (pixels)
+#define TRACKER_WINDOW 24
+
+// Frames the pointer may go unseen in its window before it's considered lost
+#define TRACKER_MAX_MISSES 2
+
+// Frame interval assumed when frames have no capture time (nanoseconds)
+#define TRACKER_DEFAULT_DT 33333333
+
+/* alpha and beta are the filter's position and velocity gains. Larger values
+ * follow sudden changes in motion more closely but pass along more of the
+ * detector's jitter.
+ */
+class PointerTracker {
+public:
+    explicit PointerTracker(float alpha = 0.85f, float beta = 0.3f);
+
+    // Returns true if a pointer is being followed
+    bool isTracking() const;
+
+    /* Returns the window the pointer is expected to be in at the given time,
+     * clipped to an image of the given size. Only valid while tracking.
+     */
+    CvRect predict(uint64_t time, CvSize imageSize) const;
+
+    // Returns where the pointer is expected to be at the given time
+    CvPoint2D32f position(uint64_t time) const;
+
+    /* Returns the index of the point closest to the predicted position for
+     * the given time, or -1 if points is empty. If not tracking, returns the
+     * first point.
+     */
+    int closest(const std::vector<CvPoint>& points, uint64_t time) const;
+
+    /* Corrects the estimate with the position the pointer was found at. Starts
+     * tracking if the pointer was lost.
+     */
+    void update(CvPoint point, uint64_t time);
+
+    /* Records that the pointer wasn't in its window. The window grows with
+     * each miss, and after TRACKER_MAX_MISSES the pointer is considered lost.
+     */
+    void miss();
+
+    // Forgets the pointer
+    void reset();
+
+private:
+    float m_alpha;
+    float m_beta;
+
+    bool m_tracking = false;
+    unsigned int m_misses = 0;
+
+    // Estimated position (pixels) and velocity (pixels per second)
+    float m_x = 0.f;
+    float m_y = 0.f;
+    float m_vx = 0.f;
+    float m_vy = 0.f;
+
+    // Capture time of the last update
+    uint64_t m_time = 0;
+
+    // Seconds from the last update to the given time
+    float elapsed(uint64_t time) const;
+};
+
+#endif // POINTER_TRACKER_HPP
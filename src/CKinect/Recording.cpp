@@ -0,0 +1,439 @@
+/* Recording of raw RGB and depth frames with their device timestamps, so a
+   session can be played back later. Frames are written by a background
+   thread and read back through a memory-mapped file. */
+
+#include "Recording.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char headerMagic[8] = {'K', 'B', 'R', 'E', 'C', 'O', 'R', 'D'};
+static const char frameMagic[4] = {'K', 'B', 'F', 'R'};
+static const char footerMagic[8] = {'K', 'B', 'I', 'N', 'D', 'E', 'X', ' '};
+
+static uint64_t alignUp(uint64_t size) {
+    return (size + RECORDING_ALIGN - 1) / RECORDING_ALIGN * RECORDING_ALIGN;
+}
+
+Recorder::Recorder(unsigned int queueFrames) : m_queueFrames(queueFrames) {
+}
+
+Recorder::~Recorder() {
+    stop();
+}
+
+int Recorder::start(const std::string& fileName,
+                    const RecordingStreamInfo streams[RECORDING_STREAMS]) {
+    if (m_recording || m_thread.joinable()) {
+        return 1;
+    }
+
+    m_file = std::fopen(fileName.c_str(), "wb");
+    if (m_file == nullptr) {
+        std::fprintf(stderr, "failed to open recording %s\n", fileName.c_str());
+        return 1;
+    }
+
+    RecordingHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, headerMagic, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.streamCount = RECORDING_STREAMS;
+
+    // Every slot must be able to hold a frame from either stream
+    uint32_t slotSize = 0;
+    for (unsigned int i = 0; i < RECORDING_STREAMS; i++) {
+        header.streams[i] = streams[i];
+        slotSize = std::max(slotSize, streams[i].width * streams[i].height *
+                                      streams[i].bytesPerPixel);
+    }
+
+    // Allocate the slots up front so push() never has to
+    if (slotSize != m_slotSize || m_slots.size() != m_queueFrames) {
+        m_slots.clear();
+        m_slots.resize(m_queueFrames);
+        for (auto& slot : m_slots) {
+            slot.data = std::make_unique<uint8_t[]>(slotSize);
+        }
+        m_slotSize = slotSize;
+    }
+
+    m_head = 0;
+    m_count = 0;
+    m_stopping = false;
+    m_dropped = 0;
+    m_offset = 0;
+    m_writeFailed = false;
+    m_index.clear();
+
+    writePadded(&header, sizeof(header));
+
+    m_startTime = std::chrono::steady_clock::now();
+    m_thread = std::thread(&Recorder::writerMain, this);
+    m_recording = true;
+
+    return 0;
+}
+
+int Recorder::stop() {
+    if (!m_thread.joinable()) {
+        return 1;
+    }
+
+    // Refuse new frames, then let the writer drain the queue
+    m_recording = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    RecordingFooter footer;
+    std::memcpy(footer.magic, footerMagic, sizeof(footer.magic));
+    footer.indexOffset = m_offset;
+    footer.frameCount = m_index.size();
+
+    if (!m_index.empty() &&
+            std::fwrite(&m_index[0], sizeof(RecordingIndexEntry),
+                        m_index.size(), m_file) != m_index.size()) {
+        m_writeFailed = true;
+    }
+    if (std::fwrite(&footer, sizeof(footer), 1, m_file) != 1) {
+        m_writeFailed = true;
+    }
+    if (std::fclose(m_file) != 0) {
+        m_writeFailed = true;
+    }
+    m_file = nullptr;
+
+    if (m_writeFailed) {
+        std::fprintf(stderr, "failed to write recording\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+bool Recorder::isRecording() const {
+    return m_recording;
+}
+
+bool Recorder::push(int stream, const uint8_t* data, uint32_t size,
+                    uint32_t timestamp) {
+    if (!m_recording) {
+        return false;
+    }
+
+    uint64_t hostTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_startTime).count();
+
+    // Reserve the next slot in the ring
+    unsigned int index;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_stopping || m_count == m_slots.size() || size > m_slotSize) {
+            m_dropped++;
+            return false;
+        }
+
+        index = (m_head + m_count) % m_slots.size();
+        m_count++;
+        m_slots[index].ready = false;
+    }
+
+    // The writer won't touch the slot until it's marked ready
+    Slot& slot = m_slots[index];
+    std::memcpy(slot.data.get(), data, size);
+
+    std::memset(&slot.header, 0, sizeof(slot.header));
+    std::memcpy(slot.header.magic, frameMagic, sizeof(slot.header.magic));
+    slot.header.stream = stream;
+    slot.header.timestamp = timestamp;
+    slot.header.size = size;
+    slot.header.hostTime = hostTime;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        slot.ready = true;
+    }
+    m_cond.notify_one();
+
+    return true;
+}
+
+unsigned int Recorder::droppedFrames() const {
+    return m_dropped;
+}
+
+void Recorder::writerMain() {
+    while (1) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // Frames are written in the order their slots were reserved
+        m_cond.wait(lock, [this] {
+            return (m_count > 0 && m_slots[m_head].ready) ||
+                   (m_stopping && m_count == 0);
+        });
+
+        if (m_count == 0) {
+            // Stopping and everything has been written
+            break;
+        }
+
+        Slot& slot = m_slots[m_head];
+        lock.unlock();
+
+        RecordingIndexEntry entry;
+        entry.offset = m_offset;
+        entry.hostTime = slot.header.hostTime;
+        entry.stream = slot.header.stream;
+        entry.timestamp = slot.header.timestamp;
+        m_index.push_back(entry);
+
+        writePadded(&slot.header, sizeof(slot.header));
+        writePadded(slot.data.get(), slot.header.size);
+
+        lock.lock();
+        m_head = (m_head + 1) % m_slots.size();
+        m_count--;
+    }
+}
+
+void Recorder::writePadded(const void* data, uint32_t size) {
+    static const uint8_t zeros[RECORDING_ALIGN] = {0};
+    uint32_t padding = alignUp(size) - size;
+
+    if (std::fwrite(data, 1, size, m_file) != size ||
+            std::fwrite(zeros, 1, padding, m_file) != padding) {
+        m_writeFailed = true;
+    }
+
+    m_offset += size + padding;
+}
+
+RecordingReader::~RecordingReader() {
+    close();
+}
+
+int RecordingReader::open(const std::string& fileName) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::fprintf(stderr, "failed to open recording %s\n", fileName.c_str());
+        return 1;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) ||
+            static_cast<uint64_t>(size.QuadPart) < sizeof(RecordingHeader)) {
+        std::fprintf(stderr, "%s is not a recording\n", fileName.c_str());
+        CloseHandle(file);
+        return 1;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0,
+                                        nullptr);
+    void* data = nullptr;
+    if (mapping != nullptr) {
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (data == nullptr) {
+        std::fprintf(stderr, "failed to map recording %s\n", fileName.c_str());
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return 1;
+    }
+
+    m_fileHandle = file;
+    m_mapHandle = mapping;
+    m_size = size.QuadPart;
+#else
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::fprintf(stderr, "failed to open recording %s\n", fileName.c_str());
+        return 1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 ||
+            static_cast<uint64_t>(info.st_size) < sizeof(RecordingHeader)) {
+        std::fprintf(stderr, "%s is not a recording\n", fileName.c_str());
+        ::close(fd);
+        return 1;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        std::fprintf(stderr, "failed to map recording %s\n", fileName.c_str());
+        return 1;
+    }
+
+    m_size = info.st_size;
+#endif
+
+    m_data = static_cast<const uint8_t*>(data);
+
+    const RecordingHeader& head = header();
+    if (std::memcmp(head.magic, headerMagic, sizeof(head.magic)) != 0 ||
+            head.version != RECORDING_VERSION ||
+            head.streamCount != RECORDING_STREAMS) {
+        std::fprintf(stderr, "%s is not a recording\n", fileName.c_str());
+        close();
+        return 1;
+    }
+
+    // Use the stored index if the recording was closed properly
+    bool haveIndex = false;
+    if (m_size >= sizeof(RecordingHeader) + sizeof(RecordingFooter)) {
+        const RecordingFooter* footer = reinterpret_cast<const RecordingFooter*>(
+            m_data + m_size - sizeof(RecordingFooter));
+
+        // Written so a damaged footer can't overflow the arithmetic
+        uint64_t indexSpace = m_size - sizeof(RecordingFooter);
+        haveIndex = std::memcmp(footer->magic, footerMagic,
+                                sizeof(footer->magic)) == 0 &&
+                    footer->indexOffset >= sizeof(RecordingHeader) &&
+                    footer->indexOffset <= indexSpace &&
+                    footer->frameCount == (indexSpace - footer->indexOffset) /
+                        sizeof(RecordingIndexEntry) &&
+                    (indexSpace - footer->indexOffset) %
+                        sizeof(RecordingIndexEntry) == 0;
+
+        if (haveIndex) {
+            m_index = reinterpret_cast<const RecordingIndexEntry*>(
+                m_data + footer->indexOffset);
+            m_frameCount = footer->frameCount;
+
+            // Every frame must lie before the index; if not, walk the frames
+            for (uint64_t i = 0; i < m_frameCount && haveIndex; i++) {
+                haveIndex = frameInBounds(m_index[i].offset,
+                                          footer->indexOffset);
+            }
+
+            if (!haveIndex) {
+                std::fprintf(stderr, "%s has a damaged index; rebuilding it\n",
+                             fileName.c_str());
+                m_index = nullptr;
+                m_frameCount = 0;
+            }
+        }
+    }
+
+    if (!haveIndex) {
+        rebuildIndex();
+    }
+
+    return 0;
+}
+
+void RecordingReader::close() {
+    if (m_data != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapHandle);
+        CloseHandle(m_fileHandle);
+        m_mapHandle = nullptr;
+        m_fileHandle = nullptr;
+#else
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+    m_index = nullptr;
+    m_frameCount = 0;
+    m_rebuiltIndex.clear();
+}
+
+bool RecordingReader::isOpen() const {
+    return m_data != nullptr;
+}
+
+const RecordingHeader& RecordingReader::header() const {
+    return *reinterpret_cast<const RecordingHeader*>(m_data);
+}
+
+unsigned int RecordingReader::frameCount() const {
+    return m_frameCount;
+}
+
+const RecordingIndexEntry& RecordingReader::indexEntry(unsigned int frame) const {
+    return m_index[frame];
+}
+
+const RecordingFrame& RecordingReader::frameHeader(unsigned int frame) const {
+    return *reinterpret_cast<const RecordingFrame*>(m_data + m_index[frame].offset);
+}
+
+const uint8_t* RecordingReader::frameData(unsigned int frame) const {
+    return m_data + m_index[frame].offset + sizeof(RecordingFrame);
+}
+
+unsigned int RecordingReader::seek(uint64_t hostTime) const {
+    // Frames are written in host time order
+    const RecordingIndexEntry* entry = std::lower_bound(
+        m_index, m_index + m_frameCount, hostTime,
+        [] (const RecordingIndexEntry& lhs, uint64_t rhs) {
+            return lhs.hostTime < rhs;
+        });
+
+    return entry - m_index;
+}
+
+bool RecordingReader::frameInBounds(uint64_t offset, uint64_t end) const {
+    if (offset < sizeof(RecordingHeader) || offset > end ||
+            end - offset < sizeof(RecordingFrame)) {
+        return false;
+    }
+
+    const RecordingFrame* frame =
+        reinterpret_cast<const RecordingFrame*>(m_data + offset);
+
+    return std::memcmp(frame->magic, frameMagic, sizeof(frame->magic)) == 0 &&
+           frame->size <= end - offset - sizeof(RecordingFrame);
+}
+
+void RecordingReader::rebuildIndex() {
+    uint64_t offset = sizeof(RecordingHeader);
+
+    // Stop at the first frame that's incomplete or damaged
+    while (frameInBounds(offset, m_size)) {
+        const RecordingFrame* frame =
+            reinterpret_cast<const RecordingFrame*>(m_data + offset);
+
+        RecordingIndexEntry entry;
+        entry.offset = offset;
+        entry.hostTime = frame->hostTime;
+        entry.stream = frame->stream;
+        entry.timestamp = frame->timestamp;
+        m_rebuiltIndex.push_back(entry);
+
+        offset += sizeof(RecordingFrame) + alignUp(frame->size);
+    }
+
+    m_index = m_rebuiltIndex.data();
+    m_frameCount = m_rebuiltIndex.size();
+}
@@ -0,0 +1,229 @@
+/* Recording of raw RGB and depth frames with their device timestamps, so a
+   session can be played back later. Frames are written by a background
+   thread and read back through a memory-mapped file. */
+
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* File layout (all fields little-endian):
+ *   RecordingHeader
+ *   RecordingFrame followed by its payload, repeated once per frame
+ *   RecordingIndexEntry, repeated once per frame
+ *   RecordingFooter
+ * Every frame header and payload starts on a 64 byte boundary so frames can
+ * be used in place from a mapping of the file. A file whose recording was
+ * cut short has no index or footer; the reader rebuilds the index by walking
+ * the frames instead.
+ */
+
+#define RECORDING_VERSION 1
+
+// Streams
+#define RECORDING_VIDEO 0
+#define RECORDING_DEPTH 1
+#define RECORDING_STREAMS 2
+
+// Frame and payload alignment within the file
+#define RECORDING_ALIGN 64
+
+class RecordingStreamInfo {
+public:
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel;
+    uint32_t reserved;
+};
+
+class RecordingHeader {
+public:
+    char magic[8]; // "KBRECORD"
+    uint32_t version;
+    uint32_t streamCount;
+    RecordingStreamInfo streams[RECORDING_STREAMS];
+    uint8_t reserved[16];
+};
+
+class RecordingFrame {
+public:
+    char magic[4]; // "KBFR"
+    uint32_t stream;
+    uint32_t timestamp; // Device timestamp
+    uint32_t size; // Payload size in bytes
+    uint64_t hostTime; // Nanoseconds since the recording started
+    uint8_t reserved[40];
+};
+
+class RecordingIndexEntry {
+public:
+    uint64_t offset; // File offset of the frame's RecordingFrame
+    uint64_t hostTime;
+    uint32_t stream;
+    uint32_t timestamp;
+};
+
+class RecordingFooter {
+public:
+    char magic[8]; // "KBINDEX "
+    uint64_t indexOffset;
+    uint64_t frameCount;
+};
+
+static_assert(sizeof(RecordingHeader) == RECORDING_ALIGN,
+              "RecordingHeader must fill one alignment unit");
+static_assert(sizeof(RecordingFrame) == RECORDING_ALIGN,
+              "RecordingFrame must fill one alignment unit");
+static_assert(sizeof(RecordingIndexEntry) == 24,
+              "RecordingIndexEntry must not be padded");
+static_assert(sizeof(RecordingFooter) == 24,
+              "RecordingFooter must not be padded");
+
+/* Writes frames to a recording. push() only copies the frame into a free
+ * preallocated slot; a background thread does the file I/O. If the writer
+ * falls behind and every slot is full, frames are dropped rather than making
+ * the caller wait.
+ */
+class Recorder {
+public:
+    explicit Recorder(unsigned int queueFrames = 16);
+    ~Recorder();
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    /* Creates the file and starts the writer thread. streams describes the
+     * video and depth streams. Returns 0 on success and 1 on failure.
+     */
+    int start(const std::string& fileName,
+              const RecordingStreamInfo streams[RECORDING_STREAMS]);
+
+    /* Writes the frames still queued, then the index, and closes the file.
+     * Returns 0 on success and 1 if anything failed to be written.
+     */
+    int stop();
+
+    bool isRecording() const;
+
+    /* Queues a copy of a frame. Returns false if the recorder isn't running or
+     * no slot was free.
+     */
+    bool push(int stream, const uint8_t* data, uint32_t size,
+              uint32_t timestamp);
+
+    // Returns the number of frames dropped since start()
+    unsigned int droppedFrames() const;
+
+private:
+    class Slot {
+    public:
+        std::unique_ptr<uint8_t[]> data;
+        RecordingFrame header;
+
+        // Set once the producer has finished copying into the slot
+        bool ready = false;
+    };
+
+    unsigned int m_queueFrames;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    // Ring of slots in the order they were reserved
+    std::vector<Slot> m_slots;
+    uint32_t m_slotSize = 0;
+    unsigned int m_head = 0;
+    unsigned int m_count = 0;
+
+    bool m_stopping = false;
+    std::atomic<bool> m_recording{false};
+    std::atomic<unsigned int> m_dropped{0};
+
+    std::chrono::steady_clock::time_point m_startTime;
+
+    std::FILE* m_file = nullptr;
+    uint64_t m_offset = 0;
+    bool m_writeFailed = false;
+
+    // Built by the writer thread and written by stop()
+    std::vector<RecordingIndexEntry> m_index;
+
+    std::thread m_thread;
+
+    void writerMain();
+
+    // Writes size bytes followed by zeros up to the next RECORDING_ALIGN
+    void writePadded(const void* data, uint32_t size);
+};
+
+/* Read-only view of a recording mapped into memory. Frames are returned as
+ * pointers into the mapping and stay valid until close().
+ */
+class RecordingReader {
+public:
+    RecordingReader() = default;
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    /* Maps the file and loads its index. Every indexed frame and its payload
+     * are inside the file, but may still belong to an unknown stream or have
+     * an unexpected size. Returns 0 on success, 1 on failure.
+     */
+    int open(const std::string& fileName);
+    void close();
+
+    bool isOpen() const;
+
+    const RecordingHeader& header() const;
+
+    unsigned int frameCount() const;
+
+    const RecordingIndexEntry& indexEntry(unsigned int frame) const;
+
+    const RecordingFrame& frameHeader(unsigned int frame) const;
+
+    const uint8_t* frameData(unsigned int frame) const;
+
+    /* Returns the first frame recorded at or after the given host time, or
+     * frameCount() if there is none
+     */
+    unsigned int seek(uint64_t hostTime) const;
+
+private:
+    const uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+
+#ifdef _WIN32
+    void* m_fileHandle = nullptr;
+    void* m_mapHandle = nullptr;
+#endif
+
+    // Points into the mapping, or at m_rebuiltIndex for truncated files
+    const RecordingIndexEntry* m_index = nullptr;
+    uint64_t m_frameCount = 0;
+
+    std::vector<RecordingIndexEntry> m_rebuiltIndex;
+
+    /* Returns true if a frame header with the right magic starts at offset,
+     * and it and its payload end at or before end
+     */
+    bool frameInBounds(uint64_t offset, uint64_t end) const;
+
+    /* Walks the frames of a file without a footer, or with a damaged index,
+     * to rebuild its index
+     */
+    void rebuildIndex();
+};
+
+#endif // RECORDING_HPP
@@ -0,0 +1,105 @@
+/* Plays a recording back into the rgb and depth NStreams in place of the
+   device, through the same buffers and newFrame callbacks. */
+
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "NStream.hpp"
+#include "Recording.hpp"
+
+// Pacing modes
+#define REPLAY_ORIGINAL 0 // Frames are published at their recorded times
+#define REPLAY_FIXED_RATE 1 // Video frames are published at a fixed rate
+#define REPLAY_MAX_SPEED 2 // Frames are published as fast as possible
+
+template <class T>
+class ReplaySource {
+public:
+    ReplaySource(NStream<T>& video, NStream<T>& depth);
+    ~ReplaySource();
+
+    ReplaySource(const ReplaySource&) = delete;
+    ReplaySource& operator=(const ReplaySource&) = delete;
+
+    /* Opens a recording. Fails if its frames don't match the sizes of the
+     * streams. Returns 0 on success and 1 on failure.
+     */
+    int open(const std::string& fileName);
+
+    /* Sets how frames are paced. fps is only used by REPLAY_FIXED_RATE, which
+     * publishes depth frames as they come between the video frames.
+     */
+    void setPacing(int pacing, double fps = 30.0);
+
+    // Restarts from the first frame when the end of the recording is reached
+    void setLoop(bool loop);
+
+    /* Sets a function to call from the replay thread when the end of the
+     * recording is reached without looping, after both streams have been
+     * brought down. Not called if stop() ends the replay.
+     */
+    void setFinished(std::function<void()> finished);
+
+    /* Starts publishing frames. A replay that reached the end of its
+     * recording can be started again without calling stop() first. Returns 0
+     * on success and 1 on failure.
+     */
+    int start();
+
+    // Stops publishing and waits for the replay thread to exit
+    void stop();
+
+    // Returns true until the end of the recording is reached or stop()
+    bool isRunning() const;
+
+    // Returns the number of video frames published since start()
+    unsigned int framesPlayed() const;
+
+    // Returns the rate video frames have been published at since start()
+    double framesPerSecond() const;
+
+private:
+    NStream<T>& m_video;
+    NStream<T>& m_depth;
+
+    RecordingReader m_reader;
+
+    int m_pacing = REPLAY_ORIGINAL;
+    double m_fps = 30.0;
+    bool m_loop = false;
+    std::function<void()> m_finished;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+
+    // Lets stop() interrupt the wait between frames
+    std::mutex m_waitMutex;
+    std::condition_variable m_waitCond;
+
+    std::atomic<unsigned int> m_framesPlayed{0};
+    std::chrono::steady_clock::time_point m_startTime;
+    std::atomic<int64_t> m_elapsedNs{0};
+
+    void threadMain();
+
+    // Joins the replay thread if it exited on its own at the end of the file
+    void joinFinished();
+
+    // Waits until the given time or until stop() is called
+    void waitUntil(std::chrono::steady_clock::time_point time);
+};
+
+#include "Replay.inl"
+
+#endif // REPLAY_HPP
@@ -0,0 +1,228 @@
+/*
+ * Plays a recording back into the rgb and depth NStreams in place of the
+ * device. Each frame is copied into the stream's write buffer and published
+ * with commitFrame(), exactly as rgb_cb and depth_cb do, so everything
+ * downstream runs unchanged.
+ */
+
+template <class T>
+ReplaySource<T>::ReplaySource(NStream<T>& video, NStream<T>& depth) :
+        m_video(video),
+        m_depth(depth) {
+}
+
+template <class T>
+ReplaySource<T>::~ReplaySource() {
+    stop();
+}
+
+template <class T>
+int ReplaySource<T>::open(const std::string& fileName) {
+    if (m_running) {
+        return 1;
+    }
+
+    // The old thread may still be reading the mapping open() replaces
+    joinFinished();
+
+    if (m_reader.open(fileName) != 0) {
+        return 1;
+    }
+
+    const RecordingStreamInfo* streams = m_reader.header().streams;
+    if (streams[RECORDING_VIDEO].width * streams[RECORDING_VIDEO].height *
+            streams[RECORDING_VIDEO].bytesPerPixel != m_video.bufSize ||
+            streams[RECORDING_DEPTH].width * streams[RECORDING_DEPTH].height *
+            streams[RECORDING_DEPTH].bytesPerPixel != m_depth.bufSize) {
+        std::fprintf(stderr, "%s doesn't match the stream sizes\n",
+                     fileName.c_str());
+        m_reader.close();
+        return 1;
+    }
+
+    return 0;
+}
+
+template <class T>
+void ReplaySource<T>::setPacing(int pacing, double fps) {
+    m_pacing = pacing;
+    m_fps = fps;
+}
+
+template <class T>
+void ReplaySource<T>::setLoop(bool loop) {
+    m_loop = loop;
+}
+
+template <class T>
+void ReplaySource<T>::setFinished(std::function<void()> finished) {
+    m_finished = std::move(finished);
+}
+
+template <class T>
+int ReplaySource<T>::start() {
+    joinFinished();
+
+    if (!m_reader.isOpen() || m_reader.frameCount() == 0 ||
+            m_thread.joinable()) {
+        return 1;
+    }
+
+    if (m_pacing == REPLAY_FIXED_RATE && m_fps <= 0.0) {
+        return 1;
+    }
+
+    m_framesPlayed = 0;
+    m_elapsedNs = 0;
+    m_startTime = std::chrono::steady_clock::now();
+
+    m_running = true;
+    m_thread = std::thread(&ReplaySource<T>::threadMain, this);
+
+    return 0;
+}
+
+template <class T>
+void ReplaySource<T>::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_running = false;
+    }
+    m_waitCond.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+template <class T>
+bool ReplaySource<T>::isRunning() const {
+    return m_running;
+}
+
+template <class T>
+unsigned int ReplaySource<T>::framesPlayed() const {
+    return m_framesPlayed;
+}
+
+template <class T>
+double ReplaySource<T>::framesPerSecond() const {
+    int64_t elapsed = m_elapsedNs;
+    if (elapsed == 0) {
+        return 0.0;
+    }
+
+    return m_framesPlayed * 1e9 / elapsed;
+}
+
+template <class T>
+void ReplaySource<T>::threadMain() {
+    using namespace std::chrono;
+
+    auto passStart = steady_clock::now();
+    auto framePeriod = duration_cast<steady_clock::duration>(
+        duration<double>(m_pacing == REPLAY_FIXED_RATE ? 1.0 / m_fps : 0.0));
+    auto nextVideoTime = passStart;
+
+    unsigned int frame = 0;
+    bool finished = false;
+
+    // Frames in this pass that weren't skipped as damaged
+    unsigned int usable = 0;
+
+    while (m_running) {
+        if (frame == m_reader.frameCount()) {
+            // Don't spin over a recording that has nothing to play
+            if (!m_loop || usable == 0) {
+                finished = true;
+                break;
+            }
+
+            // Start the next pass over the recording from now
+            frame = 0;
+            usable = 0;
+            passStart = steady_clock::now();
+        }
+
+        const RecordingIndexEntry& entry = m_reader.indexEntry(frame);
+
+        // Skip damaged frames rather than reading past the end of them
+        if (entry.stream >= RECORDING_STREAMS) {
+            frame++;
+            continue;
+        }
+
+        NStream<T>& stream = (entry.stream == RECORDING_VIDEO) ? m_video : m_depth;
+        if (m_reader.frameHeader(frame).size != stream.bufSize) {
+            frame++;
+            continue;
+        }
+        usable++;
+
+        if (m_pacing == REPLAY_ORIGINAL) {
+            waitUntil(passStart + nanoseconds(entry.hostTime));
+        }
+        else if (m_pacing == REPLAY_FIXED_RATE &&
+                 entry.stream == RECORDING_VIDEO) {
+            waitUntil(nextVideoTime);
+            nextVideoTime += framePeriod;
+        }
+
+        if (!m_running) {
+            break;
+        }
+
+        // Frames are only published while their stream is up, as with the device
+        if (stream.state == NSTREAM_UP) {
+            std::memcpy(stream.writeBuffer(), m_reader.frameData(frame),
+                        stream.bufSize);
+
+            if (stream.commitFrame(entry.timestamp) &&
+                    stream.newFrame != nullptr) {
+                stream.newFrame(stream, stream.callbackarg);
+            }
+
+            if (entry.stream == RECORDING_VIDEO) {
+                m_framesPlayed++;
+                m_elapsedNs = duration_cast<nanoseconds>(
+                    steady_clock::now() - m_startTime).count();
+            }
+        }
+
+        frame++;
+    }
+
+    m_running = false;
+
+    if (!finished) {
+        return;
+    }
+
+    /* Nothing produces frames for the streams anymore, so bring them down as
+     * the device's thread does when it closes the device
+     */
+    for (NStream<T>* stream : {&m_video, &m_depth}) {
+        auto oldState = NSTREAM_UP;
+        if (stream->state.compare_exchange_strong(oldState, NSTREAM_DOWN) &&
+                stream->streamStopping != nullptr) {
+            stream->streamStopping(*stream, stream->callbackarg);
+        }
+    }
+
+    if (m_finished != nullptr) {
+        m_finished();
+    }
+}
+
+template <class T>
+void ReplaySource<T>::joinFinished() {
+    if (m_thread.joinable() && !m_running) {
+        m_thread.join();
+    }
+}
+
+template <class T>
+void ReplaySource<T>::waitUntil(std::chrono::steady_clock::time_point time) {
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    m_waitCond.wait_until(lock, time, [this] { return !m_running; });
+}
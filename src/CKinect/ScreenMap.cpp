@@ -0,0 +1,128 @@
+/* Per-pixel lookup table from the Kinect's RGB image to the screen, with the
+   camera's lens distortion taken out. Built once when the screen is found;
+   afterwards mapping a candidate point is a single table read. */
+
+#include <cmath>
+
+#include "ScreenMap.hpp"
+
+LensModel LensModel::kinectRGB() {
+    LensModel lens;
+
+    lens.width = 640;
+    lens.height = 480;
+
+    lens.fx = 529.215f;
+    lens.fy = 525.564f;
+    lens.cx = 328.943f;
+    lens.cy = 267.481f;
+
+    lens.k1 = 0.264516f;
+    lens.k2 = -0.839907f;
+    lens.k3 = 0.911925f;
+
+    lens.p1 = -0.001992f;
+    lens.p2 = 0.001437f;
+
+    return lens;
+}
+
+CvPoint2D32f LensModel::undistort(CvPoint2D32f point, CvSize size) const {
+    float scaleX = static_cast<float>(size.width) / width;
+    float scaleY = static_cast<float>(size.height) / height;
+
+    float sfx = fx * scaleX;
+    float sfy = fy * scaleY;
+    float scx = cx * scaleX;
+    float scy = cy * scaleY;
+
+    // Normalized coordinates of the distorted point
+    float x0 = (point.x - scx) / sfx;
+    float y0 = (point.y - scy) / sfy;
+
+    /* The distortion model has no closed-form inverse, so refine the estimate
+     * by fixed-point iteration the way cvUndistortPoints() does. It converges
+     * in a few steps for the mild distortion of the Kinect's lens.
+     */
+    float x = x0;
+    float y = y0;
+    for (int i = 0; i < 5; i++) {
+        float r2 = x * x + y * y;
+        float icdist = 1.f / (1.f + ((k3 * r2 + k2) * r2 + k1) * r2);
+        float dx = 2.f * p1 * x * y + p2 * (r2 + 2.f * x * x);
+        float dy = p1 * (r2 + 2.f * y * y) + 2.f * p2 * x * y;
+        x = (x0 - dx) * icdist;
+        y = (y0 - dy) * icdist;
+    }
+
+    return cvPoint2D32f(x * sfx + scx, y * sfy + scy);
+}
+
+bool ScreenMap::build(const CvPoint corners[4], const LensModel& lens,
+                      CvSize size) {
+    m_entries.reset();
+    m_size = cvSize(0, 0);
+
+    CvPoint2D32f undistorted[4];
+    for (int i = 0; i < 4; i++) {
+        undistorted[i] = lens.undistort(
+            cvPoint2D32f(corners[i].x, corners[i].y), size);
+    }
+
+    Homography homography;
+    if (!homography.build(undistorted)) {
+        return false;
+    }
+
+    m_entries = std::make_unique<Entry[]>(size.width * size.height);
+    m_size = size;
+
+    for (int y = 0; y < size.height; y++) {
+        for (int x = 0; x < size.width; x++) {
+            CvPoint2D32f point = homography.map(
+                lens.undistort(cvPoint2D32f(x, y), size));
+
+            /* Pixels far from the screen can map anywhere, including past
+             * the horizon of the transform. Only whether they're outside the
+             * unit square matters, so keep them in range of the fixed point.
+             */
+            float u = std::fmax(-4.f, std::fmin(4.f, point.x));
+            float v = std::fmax(-4.f, std::fmin(4.f, point.y));
+
+            Entry& entry = m_entries[y * size.width + x];
+            entry.x = static_cast<int32_t>(std::floor(u * SCREENMAP_ONE + 0.5f));
+            entry.y = static_cast<int32_t>(std::floor(v * SCREENMAP_ONE + 0.5f));
+        }
+    }
+
+    return true;
+}
+
+bool ScreenMap::isValid() const {
+    return m_entries != nullptr;
+}
+
+bool ScreenMap::contains(CvPoint point) const {
+    if (point.x < 0 || point.y < 0 || point.x >= m_size.width ||
+            point.y >= m_size.height) {
+        return false;
+    }
+
+    const Entry& entry = at(point);
+    return entry.x >= 0 && entry.x < SCREENMAP_ONE &&
+           entry.y >= 0 && entry.y < SCREENMAP_ONE;
+}
+
+void ScreenMap::map(const CvPoint* in, CvPoint* out, unsigned int count,
+                    int width, int height) const {
+    for (unsigned int i = 0; i < count; i++) {
+        const Entry& entry = at(in[i]);
+
+        out[i].x = static_cast<int>(
+            (static_cast<int64_t>(entry.x) * width + SCREENMAP_ONE / 2) >>
+            SCREENMAP_FRACTION_BITS);
+        out[i].y = static_cast<int>(
+            (static_cast<int64_t>(entry.y) * height + SCREENMAP_ONE / 2) >>
+            SCREENMAP_FRACTION_BITS);
+    }
+}
@@ -0,0 +1,94 @@
+/* Per-pixel lookup table from the Kinect's RGB image to the screen, with the
+   camera's lens distortion taken out. Built once when the screen is found;
+   afterwards mapping a candidate point is a single table read. */
+
+#ifndef SCREEN_MAP_HPP
+#define SCREEN_MAP_HPP
+
+#include <opencv2/core/core_c.h>
+#include <cstdint>
+#include <memory>
+
+#include "Homography.hpp"
+
+// Fractional bits of the screen coordinates in the table
+#define SCREENMAP_FRACTION_BITS 16
+#define SCREENMAP_ONE (1 << SCREENMAP_FRACTION_BITS)
+
+/* Intrinsics and Brown-Conrady distortion coefficients of a camera, as
+ * OpenCV's calibration produces them. fx, fy, cx and cy are in pixels of an
+ * image width by height in size; they're rescaled for other resolutions.
+ */
+class LensModel {
+public:
+    int width;
+    int height;
+
+    float fx;
+    float fy;
+    float cx;
+    float cy;
+
+    // Radial
+    float k1;
+    float k2;
+    float k3;
+
+    // Tangential
+    float p1;
+    float p2;
+
+    // A typical calibration of the Kinect's RGB camera at 640x480
+    static LensModel kinectRGB();
+
+    /* Removes the distortion from a point in an image of the given size.
+     * Returns the point where an ideal pinhole camera would have seen it.
+     */
+    CvPoint2D32f undistort(CvPoint2D32f point, CvSize size) const;
+};
+
+/* Maps image pixels onto the unit square spanned by the screen, with the top
+ * left corner at (0, 0) and the bottom right at (1, 1). Entries are fixed point
+ * with SCREENMAP_FRACTION_BITS fractional bits, so points outside the screen
+ * have coordinates outside [0, SCREENMAP_ONE).
+ */
+class ScreenMap {
+public:
+    class Entry {
+    public:
+        int32_t x;
+        int32_t y;
+    };
+
+    /* Builds the table for an image of the given size. corners are where the
+     * screen's corners were found in the distorted image, in the order
+     * sortquad() leaves them. Returns false if the undistorted corners don't
+     * form a usable quadrilateral.
+     */
+    bool build(const CvPoint corners[4], const LensModel& lens, CvSize size);
+
+    bool isValid() const;
+
+    // Returns the entry for a pixel, which must be inside the image
+    const Entry& at(CvPoint point) const {
+        return m_entries[point.y * m_size.width + point.x];
+    }
+
+    /* Returns true if point is inside the image and maps onto the screen.
+     * That's tested on the corrected point, so it follows the screen's edges
+     * as they curve through the lens.
+     */
+    bool contains(CvPoint point) const;
+
+    /* Maps count points onto a width by height rectangle. Each point must be
+     * inside the image. in and out may be the same array.
+     */
+    void map(const CvPoint* in, CvPoint* out, unsigned int count, int width,
+             int height) const;
+
+private:
+    CvSize m_size = {0, 0};
+    std::unique_ptr<Entry[]> m_entries;
+};
+
+#endif // SCREEN_MAP_HPP
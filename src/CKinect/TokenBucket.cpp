@@ -0,0 +1,58 @@
+/* Token bucket for pacing how often a consumer takes frames from a stream.
+   Time is counted in whole nanoseconds of the monotonic latencyClock(), so
+   any rate can be represented and the wall clock changing has no effect. */
+
+#include "TokenBucket.hpp"
+
+TokenBucket::TokenBucket(double rate, unsigned int burst) :
+        m_burst(burst > 0 ? burst : 1) {
+    setRate(rate);
+}
+
+void TokenBucket::setRate(double rate) {
+    uint64_t interval = 0;
+    if (rate > 0.0) {
+        interval = static_cast<uint64_t>(1e9 / rate + 0.5);
+    }
+
+    m_interval.store(interval, std::memory_order_relaxed);
+}
+
+double TokenBucket::rate() const {
+    uint64_t interval = m_interval.load(std::memory_order_relaxed);
+    if (interval == 0) {
+        return 0.0;
+    }
+
+    return 1e9 / interval;
+}
+
+bool TokenBucket::take(uint64_t now) {
+    uint64_t interval = m_interval.load(std::memory_order_relaxed);
+    if (interval == 0) {
+        return true;
+    }
+
+    if (!m_started) {
+        // Start with one token so the first frame is never held back
+        m_credit = interval;
+        m_started = true;
+    }
+    else if (now > m_lastTime) {
+        m_credit += now - m_lastTime;
+    }
+    m_lastTime = now;
+
+    // Time spent with a full bucket doesn't earn any more tokens
+    uint64_t capacity = interval * m_burst;
+    if (m_credit > capacity) {
+        m_credit = capacity;
+    }
+
+    if (m_credit < interval) {
+        return false;
+    }
+
+    m_credit -= interval;
+    return true;
+}
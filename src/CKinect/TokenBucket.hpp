@@ -0,0 +1,52 @@
+/* Token bucket for pacing how often a consumer takes frames from a stream.
+   Time is counted in whole nanoseconds of the monotonic latencyClock(), so
+   any rate can be represented and the wall clock changing has no effect. */
+
+#ifndef TOKEN_BUCKET_HPP
+#define TOKEN_BUCKET_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/* Tokens that can be saved up by default. More than one lets frames that
+ * arrive a little early because of USB jitter through at the full rate.
+ */
+#define TOKENBUCKET_BURST 2
+
+/* A token is earned every 1 / rate seconds, up to burst of them. A consumer
+ * takes one per frame it processes and skips the frame if there's none.
+ */
+class TokenBucket {
+public:
+    // rate is in tokens per second; 0 means unlimited
+    explicit TokenBucket(double rate = 0.0,
+                         unsigned int burst = TOKENBUCKET_BURST);
+
+    TokenBucket(const TokenBucket&) = delete;
+    TokenBucket& operator=(const TokenBucket&) = delete;
+
+    // Changes the rate; can be called from any thread
+    void setRate(double rate);
+
+    // Returns the rate in tokens per second; 0 means unlimited
+    double rate() const;
+
+    /* Takes a token if one has been earned by now, a latencyClock() time.
+     * Returns false if the frame should be skipped. Only one thread may take
+     * tokens from a bucket. The first call always gets one.
+     */
+    bool take(uint64_t now);
+
+private:
+    // Nanoseconds per token; 0 means unlimited
+    std::atomic<uint64_t> m_interval{0};
+
+    unsigned int m_burst;
+
+    // Time saved up toward tokens, in nanoseconds
+    uint64_t m_credit = 0;
+    uint64_t m_lastTime = 0;
+    bool m_started = false;
+};
+
+#endif // TOKEN_BUCKET_HPP
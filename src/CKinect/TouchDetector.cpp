@@ -0,0 +1,77 @@
+/* Finds fingers touching the projection surface in the Kinect's depth image.
+   Learns how far away the surface is at every pixel, then marks the pixels
+   just in front of it. */
+
+#include <algorithm>
+#include <cstring>
+
+#include "TouchDetector.hpp"
+
+TouchDetector::TouchDetector(int width, int height) :
+        m_width(width),
+        m_height(height),
+        m_surface(std::make_unique<uint16_t[]>(width * height)) {
+}
+
+/* Classifies and learns one span of a row. Written without branches on the
+ * pixel values so the compiler can vectorize it.
+ */
+static void processSpan(const uint16_t* depth, uint16_t* surface,
+                        uint8_t* mask, int count, int near, int far) {
+    for (int x = 0; x < count; x++) {
+        int d = depth[x];
+        int s = surface[x];
+        int reading = d << TOUCH_FRACTION_BITS;
+
+        int valid = d < TOUCH_NO_DEPTH;
+
+        // How far in front of the surface the reading is
+        int front = ((s + (1 << (TOUCH_FRACTION_BITS - 1))) >>
+                     TOUCH_FRACTION_BITS) - d;
+        int touch = valid & (s != 0) & (front >= near) & (front <= far);
+
+        // Step toward the reading, quickly if it's farther away
+        int farther = std::min(s + TOUCH_LEARN_FARTHER, reading);
+        int nearer = std::max(s - TOUCH_LEARN_NEARER, reading);
+        int next = reading > s ? farther : nearer;
+
+        // The first valid reading a pixel gets becomes its surface
+        next = s == 0 ? reading : next;
+
+        surface[x] = static_cast<uint16_t>(valid & !touch ? next : s);
+        mask[x] = static_cast<uint8_t>(-touch);
+    }
+}
+
+void TouchDetector::process(const uint16_t* depth, const QuadSpans& spans,
+                            uint8_t* mask, int maskStride) {
+    const CvRect& bounds = spans.bounds;
+
+    for (int y = spans.top; y <= spans.bottom; y++) {
+        uint8_t* maskRow = mask + y * maskStride;
+        int x0 = spans.left[y];
+        int x1 = spans.right[y];
+
+        if (x0 > x1) {
+            std::memset(maskRow + bounds.x, 0, bounds.width);
+            continue;
+        }
+
+        // Clear the parts of the bounding rectangle outside the span
+        std::memset(maskRow + bounds.x, 0, x0 - bounds.x);
+        std::memset(maskRow + x1 + 1, 0, bounds.x + bounds.width - (x1 + 1));
+
+        unsigned int offset = y * m_width + x0;
+        processSpan(depth + offset, m_surface.get() + offset, maskRow + x0,
+                    x1 - x0 + 1, m_near, m_far);
+    }
+}
+
+void TouchDetector::setBand(int near, int far) {
+    m_near = near;
+    m_far = far;
+}
+
+void TouchDetector::reset() {
+    std::memset(m_surface.get(), 0, m_width * m_height * sizeof(uint16_t));
+}
@@ -0,0 +1,74 @@
+/* Finds fingers touching the projection surface in the Kinect's depth image.
+   Learns how far away the surface is at every pixel, then marks the pixels
+   just in front of it. */
+
+#ifndef TOUCH_DETECTOR_HPP
+#define TOUCH_DETECTOR_HPP
+
+#include <cstdint>
+#include <memory>
+
+#include "Parse.hpp"
+
+// Raw 11-bit depth value the Kinect reports when it has no reading
+#define TOUCH_NO_DEPTH 2047
+
+/* Default band in front of the surface that counts as touching, in raw depth
+ * units (about a centimeter each at the distances the Kinect is used at)
+ */
+#define TOUCH_BAND_NEAR 3
+#define TOUCH_BAND_FAR 12
+
+// Fractional bits of the learned surface depth
+#define TOUCH_FRACTION_BITS 4
+
+/* How fast the learned surface follows the depth image, in units of
+ * 1 / (1 << TOUCH_FRACTION_BITS) raw depth units per frame. The surface is the
+ * farthest thing the Kinect sees, so it's learned faster when something moves
+ * away than when something stays in front of it. The learned depth settles at
+ * the upper third of each pixel's noise.
+ */
+#define TOUCH_LEARN_FARTHER 2
+#define TOUCH_LEARN_NEARER 1
+
+/* The learned surface is a fixed-point running median of every pixel's depth
+ * that's biased away from the camera. Each frame it moves a fixed step toward
+ * the current reading. Pixels classified as touching don't update it, so a
+ * finger resting on the wall isn't learned as part of it.
+ */
+class TouchDetector {
+public:
+    TouchDetector(int width, int height);
+
+    TouchDetector(const TouchDetector&) = delete;
+    TouchDetector& operator=(const TouchDetector&) = delete;
+
+    /* Learns from an 11-bit depth frame of the detector's size, and writes
+     * 0xff to mask where it's touching and 0x00 elsewhere. Only the pixels
+     * inside spans (built for an image of the detector's size) are looked at;
+     * the rest of spans.bounds in mask is cleared and the rest of mask is left
+     * alone.
+     */
+    void process(const uint16_t* depth, const QuadSpans& spans, uint8_t* mask,
+                 int maskStride);
+
+    /* Sets how far in front of the surface (in raw depth units) a reading
+     * must be to count as touching
+     */
+    void setBand(int near, int far);
+
+    // Forgets the learned surface
+    void reset();
+
+private:
+    int m_width;
+    int m_height;
+
+    int m_near = TOUCH_BAND_NEAR;
+    int m_far = TOUCH_BAND_FAR;
+
+    // Learned surface depth per pixel; 0 until the first valid reading
+    std::unique_ptr<uint16_t[]> m_surface;
+};
+
+#endif // TOUCH_DETECTOR_HPP
@@ -0,0 +1,75 @@
+/* Lock-free triple buffer for passing frames from one producer to one
+   consumer. The producer never blocks and the consumer always gets the newest
+   complete frame. */
+
+#include "TripleBuffer.hpp"
+
+TripleBuffer::TripleBuffer(size_t bufSize) {
+    // Keep each buffer on its own cache lines
+    const size_t alignment = 64;
+    size_t stride = (bufSize + alignment - 1) / alignment * alignment;
+
+    m_memory = std::make_unique<uint8_t[]>(stride * 3 + alignment);
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(m_memory.get());
+    base = (base + alignment - 1) / alignment * alignment;
+
+    for (unsigned int i = 0; i < 3; i++) {
+        m_bufs[i] = reinterpret_cast<uint8_t*>(base + i * stride);
+    }
+}
+
+uint8_t* TripleBuffer::writeBuffer() const {
+    return m_bufs[m_back];
+}
+
+void TripleBuffer::publish(uint32_t timestamp, uint64_t captureTime) {
+    m_seqs[m_back] = m_nextSeq++;
+    m_timestamps[m_back] = timestamp;
+    m_captureTimes[m_back] = captureTime;
+
+    /* Release makes the frame and its sequence number visible to the
+     * consumer. Whatever was in the middle becomes the new back buffer.
+     */
+    unsigned int old = m_middle.exchange(m_back | fresh,
+                                         std::memory_order_acq_rel);
+    m_back = old & indexMask;
+}
+
+bool TripleBuffer::update() {
+    if ((m_middle.load(std::memory_order_relaxed) & fresh) == 0) {
+        return false;
+    }
+
+    uint64_t lastSeq = m_seqs[m_front];
+
+    unsigned int old = m_middle.exchange(m_front, std::memory_order_acq_rel);
+    m_front = old & indexMask;
+
+    /* Before the first frame the front buffer's sequence number is 0, so the
+     * first frame (1) never counts as having missed any
+     */
+    m_missed = m_seqs[m_front] - lastSeq - 1;
+
+    return true;
+}
+
+uint8_t* TripleBuffer::frontBuffer() const {
+    return m_seqs[m_front] != 0 ? m_bufs[m_front] : nullptr;
+}
+
+uint64_t TripleBuffer::frontSeq() const {
+    return m_seqs[m_front];
+}
+
+uint32_t TripleBuffer::frontTimestamp() const {
+    return m_timestamps[m_front];
+}
+
+uint64_t TripleBuffer::frontCaptureTime() const {
+    return m_captureTimes[m_front];
+}
+
+uint64_t TripleBuffer::missed() const {
+    return m_missed;
+}
@@ -0,0 +1,79 @@
+/* Lock-free triple buffer for passing frames from one producer to one
+   consumer. The producer never blocks and the consumer always gets the newest
+   complete frame. */
+
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+/* The three buffers are split between the producer (back), the consumer
+ * (front) and a middle slot the two exchange through with a single atomic
+ * swap. Each published frame gets a sequence number starting at 1, so the
+ * consumer can tell how many frames it skipped.
+ */
+class TripleBuffer {
+public:
+    explicit TripleBuffer(size_t bufSize);
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Producer: returns the buffer to fill with the next frame
+    uint8_t* writeBuffer() const;
+
+    /* Producer: publishes the filled buffer as the newest frame. Never blocks.
+     * If the consumer hasn't picked up the previous frame, it's overwritten.
+     * captureTime is the latencyClock() time the frame arrived.
+     */
+    void publish(uint32_t timestamp, uint64_t captureTime);
+
+    /* Consumer: swaps the newest published frame into the front buffer.
+     * Returns false and leaves the front buffer alone if nothing was published
+     * since the last call.
+     */
+    bool update();
+
+    // Consumer: the frame from the last successful update() (nullptr if none)
+    uint8_t* frontBuffer() const;
+
+    // Consumer: sequence number of the front frame (0 if none)
+    uint64_t frontSeq() const;
+
+    uint32_t frontTimestamp() const;
+
+    // Consumer: latencyClock() time the front frame arrived
+    uint64_t frontCaptureTime() const;
+
+    // Consumer: frames published but never seen before the last update()
+    uint64_t missed() const;
+
+private:
+    // Set in m_middle when it holds a frame the consumer hasn't seen
+    static const unsigned int fresh = 0x4;
+    static const unsigned int indexMask = 0x3;
+
+    std::unique_ptr<uint8_t[]> m_memory;
+    uint8_t* m_bufs[3];
+
+    // Written by the producer before the frame is published
+    uint64_t m_seqs[3] = {0, 0, 0};
+    uint32_t m_timestamps[3] = {0, 0, 0};
+    uint64_t m_captureTimes[3] = {0, 0, 0};
+
+    // Index of the middle buffer, plus the fresh bit
+    std::atomic<unsigned int> m_middle{1};
+
+    // Producer-owned
+    unsigned int m_back = 0;
+    uint64_t m_nextSeq = 1;
+
+    // Consumer-owned
+    unsigned int m_front = 2;
+    uint64_t m_missed = 0;
+};
+
+#endif // TRIPLE_BUFFER_HPP
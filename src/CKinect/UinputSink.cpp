@@ -0,0 +1,147 @@
+/* Pointer sink that moves a virtual absolute pointing device created through
+   Linux's uinput, so the daemon can drive the desktop like the Win32 frontend
+   does with SendInput(). Fails to open on other platforms. */
+
+#include "UinputSink.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/uinput.h>
+#endif
+
+// USB IDs of the Kinect's camera, reported by the virtual device
+#define UINPUT_VENDOR 0x045e
+#define UINPUT_PRODUCT 0x02ae
+
+UinputSink::~UinputSink() {
+    close();
+}
+
+#ifdef __linux__
+
+// Sets up one axis to cover [0, POINTER_RANGE]. Returns 0 on success.
+static int setupAxis(int fd, int code) {
+    uinput_abs_setup axis;
+    std::memset(&axis, 0, sizeof(axis));
+    axis.code = code;
+    axis.absinfo.minimum = 0;
+    axis.absinfo.maximum = POINTER_RANGE;
+
+    return ioctl(fd, UI_ABS_SETUP, &axis) < 0 ? 1 : 0;
+}
+
+int UinputSink::open(const std::string& name) {
+    if (m_fd >= 0) {
+        return 1;
+    }
+
+    m_fd = ::open("/dev/uinput", O_WRONLY);
+    if (m_fd < 0) {
+        std::fprintf(stderr, "failed to open /dev/uinput\n");
+        return 1;
+    }
+
+    /* libinput only treats absolute devices with a button as pointers, so
+     * BTN_LEFT is advertised even though it's never pressed
+     */
+    int error = 0;
+    error |= ioctl(m_fd, UI_SET_EVBIT, EV_KEY) < 0;
+    error |= ioctl(m_fd, UI_SET_KEYBIT, BTN_LEFT) < 0;
+    error |= ioctl(m_fd, UI_SET_EVBIT, EV_ABS) < 0;
+    error |= ioctl(m_fd, UI_SET_ABSBIT, ABS_X) < 0;
+    error |= ioctl(m_fd, UI_SET_ABSBIT, ABS_Y) < 0;
+    error |= setupAxis(m_fd, ABS_X);
+    error |= setupAxis(m_fd, ABS_Y);
+
+    uinput_setup setup;
+    std::memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = UINPUT_VENDOR;
+    setup.id.product = UINPUT_PRODUCT;
+    std::strncpy(setup.name, name.c_str(), UINPUT_MAX_NAME_SIZE - 1);
+
+    error |= ioctl(m_fd, UI_DEV_SETUP, &setup) < 0;
+    error |= ioctl(m_fd, UI_DEV_CREATE) < 0;
+
+    if (error != 0) {
+        std::fprintf(stderr, "failed to create uinput device\n");
+        ::close(m_fd);
+        m_fd = -1;
+        return 1;
+    }
+
+    return 0;
+}
+
+void UinputSink::close() {
+    if (m_fd < 0) {
+        return;
+    }
+
+    ioctl(m_fd, UI_DEV_DESTROY);
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+int UinputSink::submit(const PointerEvent* events, unsigned int count) {
+    if (m_fd < 0) {
+        return 1;
+    }
+
+    // The kernel fills in the times
+    input_event input;
+    std::memset(&input, 0, sizeof(input));
+
+    m_buffer.clear();
+    for (unsigned int i = 0; i < count; i++) {
+        if (!events[i].pointer) {
+            continue;
+        }
+
+        input.type = EV_ABS;
+        input.code = ABS_X;
+        input.value = events[i].x;
+        m_buffer.push_back(input);
+
+        input.code = ABS_Y;
+        input.value = events[i].y;
+        m_buffer.push_back(input);
+
+        input.type = EV_SYN;
+        input.code = SYN_REPORT;
+        input.value = 0;
+        m_buffer.push_back(input);
+    }
+
+    if (m_buffer.empty()) {
+        return 0;
+    }
+
+    ssize_t size = m_buffer.size() * sizeof(input_event);
+    if (write(m_fd, m_buffer.data(), size) != size) {
+        return 1;
+    }
+
+    return 0;
+}
+
+#else
+
+int UinputSink::open(const std::string& name) {
+    std::fprintf(stderr, "uinput is only available on Linux\n");
+    return 1;
+}
+
+void UinputSink::close() {
+}
+
+int UinputSink::submit(const PointerEvent* events, unsigned int count) {
+    return 1;
+}
+
+#endif
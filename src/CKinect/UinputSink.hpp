@@ -0,0 +1,47 @@
+/* Pointer sink that moves a virtual absolute pointing device created through
+   Linux's uinput, so the daemon can drive the desktop like the Win32 frontend
+   does with SendInput(). Fails to open on other platforms. */
+
+#ifndef UINPUT_SINK_HPP
+#define UINPUT_SINK_HPP
+
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/input.h>
+#endif
+
+#include "PointerSink.hpp"
+
+class UinputSink : public PointerSink {
+public:
+    UinputSink() = default;
+    ~UinputSink();
+
+    UinputSink(const UinputSink&) = delete;
+    UinputSink& operator=(const UinputSink&) = delete;
+
+    /* Creates the device with the given name. Needs write access to
+     * /dev/uinput. Returns 0 on success and 1 on failure.
+     */
+    int open(const std::string& name = "KinectBoard");
+
+    // Removes the device
+    void close();
+
+    /* Moves the device to the pointer of every event, with one write() for
+     * the whole batch
+     */
+    int submit(const PointerEvent* events, unsigned int count) override;
+
+private:
+    int m_fd = -1;
+
+#ifdef __linux__
+    // Reused for every batch so submitting doesn't allocate
+    std::vector<input_event> m_buffer;
+#endif
+};
+
+#endif // UINPUT_SINK_HPP
@@ -0,0 +1,176 @@
+//=============================================================================
+//File Name: DepthColorizer.cpp
+//Description: Converts raw 11-bit Kinect depth images to BGRA images using a
+//             precomputed lookup table
+//Author: Tyler Veness
+//=============================================================================
+
+#include <cmath>
+#include <cstdlib>
+#include "DepthColorizer.hpp"
+#include "Color.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DEPTH_COLORIZER_AVX2
+#endif
+
+static Color HSVtoRGB(unsigned short hue, unsigned short saturation,
+                      unsigned short value);
+
+#ifdef DEPTH_COLORIZER_AVX2
+/* Eight lookups per iteration with a hardware gather. Only called if the CPU
+ * reports AVX2 support at runtime.
+ */
+__attribute__((target("avx2")))
+static void colorizeAVX2(const uint32_t* table, const uint16_t* depth,
+                         uint32_t* bgra, unsigned int count) {
+    const __m256i mask = _mm256_set1_epi32(DepthColorizer::rawValues - 1);
+
+    unsigned int index = 0;
+    for (; index + 8 <= count; index += 8) {
+        __m128i raw = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(depth + index));
+        __m256i entry = _mm256_and_si256(_mm256_cvtepu16_epi32(raw), mask);
+        __m256i pixels = _mm256_i32gather_epi32(
+            reinterpret_cast<const int*>(table), entry, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(bgra + index), pixels);
+    }
+
+    for (; index < count; index++) {
+        bgra[index] = table[depth[index] & (DepthColorizer::rawValues - 1)];
+    }
+}
+#endif
+
+DepthColorizer::DepthColorizer(double minMeters, double maxMeters) :
+        m_minMeters(minMeters),
+        m_maxMeters(maxMeters) {
+}
+
+void DepthColorizer::setRange(double minMeters, double maxMeters) {
+    std::lock_guard<std::mutex> lock(m_rangeMutex);
+
+    if (minMeters != m_minMeters || maxMeters != m_maxMeters) {
+        m_minMeters = minMeters;
+        m_maxMeters = maxMeters;
+        m_dirty = true;
+    }
+}
+
+void DepthColorizer::colorize(const uint16_t* depth, uint32_t* bgra,
+                              unsigned int count) {
+    if (m_dirty.exchange(false)) {
+        buildTable();
+    }
+
+#ifdef DEPTH_COLORIZER_AVX2
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    if (hasAVX2) {
+        colorizeAVX2(m_table, depth, bgra, count);
+        return;
+    }
+#endif
+
+    const uint16_t mask = rawValues - 1;
+
+    unsigned int index = 0;
+    for (; index + 4 <= count; index += 4) {
+        bgra[index + 0] = m_table[depth[index + 0] & mask];
+        bgra[index + 1] = m_table[depth[index + 1] & mask];
+        bgra[index + 2] = m_table[depth[index + 2] & mask];
+        bgra[index + 3] = m_table[depth[index + 3] & mask];
+    }
+
+    for (; index < count; index++) {
+        bgra[index] = m_table[depth[index] & mask];
+    }
+}
+
+double DepthColorizer::rawDepthToMeters(unsigned short depthValue) {
+    if (depthValue < 2047) {
+        return 1.f / (static_cast<double>(depthValue) * -0.0030711016 +
+                      3.3309495161);
+    }
+
+    return 0.0;
+}
+
+void DepthColorizer::buildTable() {
+    double minMeters;
+    double maxMeters;
+    {
+        std::lock_guard<std::mutex> lock(m_rangeMutex);
+        minMeters = m_minMeters;
+        maxMeters = m_maxMeters;
+    }
+
+    for (unsigned int raw = 0; raw < rawValues; raw++) {
+        double depth = rawDepthToMeters(raw);
+
+        // Depths outside of the range (including invalid ones) are black
+        Color color{0, 0, 0};
+        if (minMeters < depth && depth < maxMeters && minMeters < maxMeters) {
+            color = HSVtoRGB(360 * (depth - minMeters) /
+                             (maxMeters - minMeters), 100, 100);
+        }
+
+        //          A          R                  G                  B
+        m_table[raw] = 0xFF000000 | (color.r << 16) | (color.g << 8) | color.b;
+    }
+}
+
+Color HSVtoRGB(unsigned short hue, unsigned short saturation,
+               unsigned short value) {
+    /* H is [0,360]
+     * S_HSV is [0,1]
+     * V is [0,1]
+     */
+
+    Color color{0, 0, 0};
+    float C = value / 100 * saturation / 100;
+    float H = hue / 60;
+    float X = C * (1 - std::abs(static_cast<int>(std::floor(H)) % 2 - 1));
+
+    if (0 <= H && H < 1) {
+        color.r = 255 * C;
+        color.g = 255 * X;
+        color.b = 0;
+    }
+    else if (1 <= H && H < 2) {
+        color.r = 255 * X;
+        color.g = 255 * C;
+        color.b = 0;
+    }
+    else if (2 <= H && H < 3) {
+        color.r = 0;
+        color.g = 255 * C;
+        color.b = 255 * X;
+    }
+    else if (3 <= H && H < 4) {
+        color.r = 0;
+        color.g = 255 * X;
+        color.b = 255 * C;
+    }
+    else if (4 <= H && H < 5) {
+        color.r = 255 * X;
+        color.g = 0;
+        color.b = 255 * C;
+    }
+    else if (5 <= H && H < 6) {
+        color.r = 255 * C;
+        color.g = 0;
+        color.b = 255 * X;
+    }
+    else {
+        return color;
+    }
+
+    float m = value - C;
+
+    color.r += m;
+    color.g += m;
+    color.b += m;
+
+    return color;
+}
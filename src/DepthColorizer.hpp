@@ -0,0 +1,55 @@
+//=============================================================================
+//File Name: DepthColorizer.hpp
+//Description: Converts raw 11-bit Kinect depth images to BGRA images using a
+//             precomputed lookup table
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * The Kinect only produces 2048 distinct raw depth values, so every color the
+ * depth view can show is computed once and stored in a table. Converting a
+ * frame is then one table lookup per pixel. The table is rebuilt lazily when
+ * the visualized depth range changes.
+ */
+
+#ifndef DEPTH_COLORIZER_HPP
+#define DEPTH_COLORIZER_HPP
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+class DepthColorizer {
+public:
+    // Number of distinct raw depth values (11 bits per pixel)
+    static const unsigned int rawValues = 2048;
+
+    DepthColorizer(double minMeters = 0.0, double maxMeters = 5.0);
+
+    /* Sets the range of depths mapped onto the hue wheel. The lookup table is
+     * only rebuilt if the range actually changed.
+     */
+    void setRange(double minMeters, double maxMeters);
+
+    /* Converts 'count' raw depth values to packed BGRA pixels. Raw values are
+     * masked to 11 bits, so any input is safe to pass.
+     */
+    void colorize(const uint16_t* depth, uint32_t* bgra, unsigned int count);
+
+    // Converts a raw depth value to meters (returns 0 for invalid readings)
+    static double rawDepthToMeters(unsigned short depthValue);
+
+private:
+    std::mutex m_rangeMutex;
+    double m_minMeters;
+    double m_maxMeters;
+
+    // Set when the range changed and the table needs to be rebuilt
+    std::atomic<bool> m_dirty{true};
+
+    alignas(64) uint32_t m_table[rawValues];
+
+    void buildTable();
+};
+
+#endif // DEPTH_COLORIZER_HPP
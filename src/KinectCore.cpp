@@ -0,0 +1,1421 @@
+//=============================================================================
+//File Name: KinectCore.cpp
+//Description: Captures from a Microsoft Kinect and tracks pointers in its
+//             images without depending on any windowing system
+//Author: Tyler Veness
+//=============================================================================
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include "KinectCore.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+KinectCore::KinectCore(int deviceIndex) : m_deviceIndex(deviceIndex) {
+    rgb.newFrame = newVideoFrame;
+    rgb.callbackarg = this;
+
+    depth.newFrame = newDepthFrame;
+    depth.callbackarg = this;
+
+    m_imageSize = {static_cast<int>(ImageVars::width), static_cast<int>(ImageVars::height)};
+
+    m_cvDepthImage = cvCreateImage(m_imageSize, IPL_DEPTH_8U, 4);
+    m_cvBitmapDest = cvCreateImage(m_imageSize, IPL_DEPTH_8U, 4);
+
+    cvInitImageHeader(&m_vidHeader, m_imageSize, IPL_DEPTH_8U, 3);
+    for (unsigned int index = 0; index < ProcColor::Size; index++) {
+        cvInitImageHeader(&m_calibHeaders[index], m_imageSize, IPL_DEPTH_8U, 3);
+    }
+
+    // Preallocate the cursor candidate lists so tracking doesn't allocate
+    m_plistRaw.reserve(64);
+    m_plistProc.reserve(64);
+    m_workspace.resize(m_imageSize);
+
+    // A replay that reaches the end of its recording stops the streams
+    m_replay.setFinished([this] {
+        streamEvent(KINECT_VIDEOSTOP);
+        streamEvent(KINECT_DEPTHSTOP);
+    });
+
+    m_detectThread = std::thread(&KinectCore::detectStage, this);
+    m_renderThread = std::thread(&KinectCore::renderStage, this);
+    m_depthRenderThread = std::thread(&KinectCore::depthRenderStage, this);
+    m_outputThread = std::thread(&KinectCore::outputStage, this);
+}
+
+KinectCore::KinectCore(const std::string& serial) : KinectCore(0) {
+    m_deviceSerial = serial;
+}
+
+KinectCore::~KinectCore() {
+    shutdown();
+
+    // Report the latencies measured during the session
+    if (m_latency[KINECT_LATENCY_FILTER].count() > 0) {
+        dumpLatency(stderr);
+    }
+
+    cvReleaseImage(&m_cvDepthImage);
+    cvReleaseImage(&m_cvBitmapDest);
+
+    // Return held frames before the stream's pool is destroyed
+    m_vidFrame.reset();
+    for (unsigned int index = 0; index < ProcColor::Size; index++) {
+        m_calibFrames[index].reset();
+    }
+}
+
+void KinectCore::shutdown() {
+    // The stage threads are only joinable until the first call
+    if (!m_outputThread.joinable()) {
+        return;
+    }
+
+    stopCapture();
+    stopVideoStream();
+    stopDepthStream();
+
+    m_replay.stop();
+
+    // The capture thread closes the device and exits as soon as it's woken
+    if (m_captureThread.joinable()) {
+        m_captureThread.join();
+    }
+
+    // Stop the pipeline stages, dropping any frames they still have queued
+    m_detectQueue.close();
+    m_renderQueue.close();
+    m_depthRenderQueue.close();
+    m_outputQueue.close();
+
+    m_detectThread.join();
+    m_renderThread.join();
+    m_depthRenderThread.join();
+    m_outputThread.join();
+}
+
+std::vector<std::string> KinectCore::listDevices() {
+    std::shared_ptr<FreenectContext> context = FreenectContext::get();
+    if (context == nullptr) {
+        return {};
+    }
+
+    return context->serials();
+}
+
+void KinectCore::startVideoStream() {
+    // If rgb image stream is down, start it
+    if (rgb.state == NSTREAM_DOWN) {
+        if (startstream(rgb) == 0) {
+            streamEvent(KINECT_VIDEOSTART);
+        }
+    }
+}
+
+void KinectCore::startDepthStream() {
+    // If depth image stream is down, start it
+    if (depth.state == NSTREAM_DOWN) {
+        if (startstream(depth) == 0) {
+            streamEvent(KINECT_DEPTHSTART);
+        }
+    }
+}
+
+void KinectCore::stopVideoStream() {
+    auto oldState = NSTREAM_UP;
+
+    // If this function was able to switch rgb's state from up to down
+    if (rgb.state.compare_exchange_strong(oldState, NSTREAM_DOWN)) {
+        // Stop its transfers, and the thread if the other stream is down too
+        setStreamWanted(rgb, false);
+
+        // Call the callback
+        if (rgb.streamStopping != nullptr) {
+            rgb.streamStopping(rgb, rgb.callbackarg);
+        }
+    }
+
+    m_foundScreen = false;
+
+    streamEvent(KINECT_VIDEOSTOP);
+}
+
+void KinectCore::stopDepthStream() {
+    auto oldState = NSTREAM_UP;
+
+    // If this function was able to switch depth's state from up to down
+    if (depth.state.compare_exchange_strong(oldState, NSTREAM_DOWN)) {
+        // Stop its transfers, and the thread if the other stream is down too
+        setStreamWanted(depth, false);
+
+        // Call the callback
+        if (depth.streamStopping != nullptr) {
+            depth.streamStopping(depth, depth.callbackarg);
+        }
+    }
+
+    streamEvent(KINECT_DEPTHSTOP);
+}
+
+bool KinectCore::isVideoStreamRunning() {
+    return rgb.state == NSTREAM_UP;
+}
+
+bool KinectCore::isDepthStreamRunning() {
+    return depth.state == NSTREAM_UP;
+}
+
+void KinectCore::setVideoStreamFPS(unsigned int fps) {
+    m_previewPacer.setRate(fps);
+}
+
+void KinectCore::setDepthStreamFPS(unsigned int fps) {
+    m_depthPacer.setRate(fps);
+}
+
+void KinectCore::setTrackingFPS(unsigned int fps) {
+    m_trackPacer.setRate(fps);
+    m_touchPacer.setRate(fps);
+}
+
+void KinectCore::setDepthRange(double minMeters, double maxMeters) {
+    m_depthColorizer.setRange(minMeters, maxMeters);
+}
+
+void KinectCore::setPointerSink(std::shared_ptr<PointerSink> sink) {
+    std::lock_guard<std::mutex> lock(m_sinkMutex);
+    m_sink = std::move(sink);
+}
+
+void KinectCore::setPreviews(bool enable) {
+    m_previews = enable;
+}
+
+bool KinectCore::saveVideo(const std::string& fileName) {
+    FrameRef frame;
+    {
+        std::lock_guard<std::mutex> lock(m_vidImageMutex);
+        frame = m_vidFrame;
+    }
+
+    if (!frame) {
+        return false;
+    }
+
+    cv::Mat img(ImageVars::height, ImageVars::width, CV_8UC(3), frame.data());
+    return cv::imwrite(fileName, img);
+}
+
+bool KinectCore::saveDepth(const std::string& fileName) {
+    cv::Mat img(ImageVars::height, ImageVars::width, CV_8UC(3), m_cvDepthImage);
+    return cv::imwrite(fileName, img);
+}
+
+bool KinectCore::startRecording(const std::string& fileName) {
+    RecordingStreamInfo streams[RECORDING_STREAMS];
+
+    streams[RECORDING_VIDEO] = {static_cast<uint32_t>(rgb.imgWidth),
+                                static_cast<uint32_t>(rgb.imgHeight),
+                                static_cast<uint32_t>(rgb.imgDepth), 0};
+    streams[RECORDING_DEPTH] = {static_cast<uint32_t>(depth.imgWidth),
+                                static_cast<uint32_t>(depth.imgHeight),
+                                static_cast<uint32_t>(depth.imgDepth), 0};
+
+    return m_recorder.start(fileName, streams) == 0;
+}
+
+bool KinectCore::stopRecording() {
+    return m_recorder.stop() == 0;
+}
+
+bool KinectCore::isRecording() const {
+    return m_recorder.isRecording();
+}
+
+bool KinectCore::startReplay(const std::string& fileName, int pacing, double fps,
+                         bool loop) {
+    // The replay takes the device's place as the streams' producer
+    if (m_captureState != KINECT_CAPTURE_STOPPED || m_replay.isRunning()) {
+        return false;
+    }
+
+    if (m_replay.open(fileName) != 0) {
+        return false;
+    }
+
+    m_replay.setPacing(pacing, fps);
+    m_replay.setLoop(loop);
+
+    rgb.state = NSTREAM_UP;
+    depth.state = NSTREAM_UP;
+
+    if (m_replay.start() != 0) {
+        rgb.state = NSTREAM_DOWN;
+        depth.state = NSTREAM_DOWN;
+        return false;
+    }
+
+    streamEvent(KINECT_VIDEOSTART);
+    streamEvent(KINECT_DEPTHSTART);
+
+    return true;
+}
+
+void KinectCore::stopReplay() {
+    m_replay.stop();
+
+    if (m_captureState == KINECT_CAPTURE_STOPPED) {
+        stopVideoStream();
+        stopDepthStream();
+    }
+}
+
+bool KinectCore::isReplaying() const {
+    return m_replay.isRunning();
+}
+
+double KinectCore::getReplayFPS() const {
+    return m_replay.framesPerSecond();
+}
+
+void KinectCore::setCalibImage(Processing::ProcColor colorWanted) {
+    if (isVideoStreamRunning() && isEnabled(colorWanted)) {
+        // Keep a reference to the current frame instead of copying it
+        std::lock_guard<std::mutex> lock(m_vidImageMutex);
+        m_calibFrames[colorWanted] = m_vidFrame;
+    }
+}
+
+void KinectCore::calibrate() {
+    IplImage* redCalib = nullptr;
+    IplImage* greenCalib = nullptr;
+    IplImage* blueCalib = nullptr;
+
+    if (isEnabled(Red) && m_calibFrames[Red]) {
+        redCalib = &m_calibHeaders[Red];
+        cvSetData(redCalib, m_calibFrames[Red].data(), ImageVars::width * 3);
+    }
+
+    if (isEnabled(Green) && m_calibFrames[Green]) {
+        greenCalib = &m_calibHeaders[Green];
+        cvSetData(greenCalib, m_calibFrames[Green].data(), ImageVars::width * 3);
+    }
+
+    if (isEnabled(Blue) && m_calibFrames[Blue]) {
+        blueCalib = &m_calibHeaders[Blue];
+        cvSetData(blueCalib, m_calibFrames[Blue].data(), ImageVars::width * 3);
+    }
+
+    // findScreenBox() takes the image size from the red image
+    if (redCalib == nullptr) {
+        m_foundScreen = false;
+        return;
+    }
+
+    // If image was disabled, nullptr is passed instead, so it's ignored
+
+    /* Use the calibration images to locate a quadrilateral in the
+     * image which represents the screen (returns 1 on failure)
+     */
+    //saveRGBimage(redCalib, (char *)"redCalib-start.data"); // TODO
+    //saveRGBimage(blueCalib, (char *)"blueCalib-start.data"); // TODO
+    setQuad(findScreenBox(redCalib, greenCalib, blueCalib));
+}
+
+bool KinectCore::setScreenQuad(const CvPoint corners[4]) {
+    Quad quad;
+    for (unsigned int i = 0; i < 4; i++) {
+        quad.point[i] = corners[i];
+    }
+    quad.validQuad = true;
+
+    setQuad(quad);
+    return m_foundScreen;
+}
+
+void KinectCore::setQuad(Quad quad) {
+    bool lensCorrection;
+    LensModel lens;
+    {
+        std::lock_guard<std::mutex> lock(m_quadMutex);
+        lensCorrection = m_lensCorrection;
+        lens = m_lens;
+    }
+
+    std::shared_ptr<QuadSpans> spans;
+    Homography homography;
+    std::shared_ptr<ScreenMap> screenMap;
+    if (quad.validQuad) {
+        sortquad(quad);
+
+        // A degenerate quadrilateral can't be mapped onto the screen
+        if (homography.build(quad.point)) {
+            spans = std::make_shared<QuadSpans>();
+            spans->build(quad, m_imageSize);
+        }
+        else {
+            quad.validQuad = false;
+        }
+    }
+
+    if (quad.validQuad && lensCorrection) {
+        screenMap = std::make_shared<ScreenMap>();
+        if (!screenMap->build(quad.point, lens, m_imageSize)) {
+            // Fall back to the uncorrected mapping
+            screenMap = nullptr;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_quadMutex);
+    m_quad = quad;
+    m_spans = spans;
+    m_homography = homography;
+    m_screenMap = screenMap;
+
+    // If no box was found, m_quad will be nullptr
+    m_foundScreen = m_quad.validQuad;
+}
+
+void KinectCore::lookForCursors() {
+    // We can't look for cursors if we never found a screen on which to look
+    if (m_foundScreen) {
+        FrameRef frame;
+        {
+            std::lock_guard<std::mutex> lock(m_vidImageMutex);
+            frame = m_vidFrame;
+        }
+
+        if (frame) {
+            m_detectQueue.push(std::move(frame));
+        }
+    }
+}
+
+PipelineStats KinectCore::getPipelineStats() const {
+    PipelineStats stats;
+
+    stats.capture = rgb.droppedFrames;
+    stats.detect = m_detectQueue.dropped();
+    stats.render = m_renderQueue.dropped();
+    unsigned int depthMissed = m_depthFramesMissed;
+    stats.pacedVideo = m_videoFramesPaced;
+    stats.pacedDepth = m_depthFramesPaced;
+    stats.depthRender = depthMissed > stats.pacedDepth ?
+                        depthMissed - stats.pacedDepth : 0;
+    stats.output = m_outputQueue.dropped();
+    stats.recording = m_recorder.droppedFrames();
+    stats.coalesced = m_outputCoalesced;
+
+    return stats;
+}
+
+LatencySummary KinectCore::getLatency(int stage) const {
+    if (stage < 0 || stage >= KINECT_LATENCY_STAGES) {
+        return LatencySummary();
+    }
+
+    return m_latency[stage].summary();
+}
+
+void KinectCore::resetLatency() {
+    for (auto& histogram : m_latency) {
+        histogram.reset();
+    }
+}
+
+void KinectCore::dumpLatency(std::FILE* file) const {
+    static const char* names[KINECT_LATENCY_STAGES] = {
+        "filter", "contours", "screen", "output", "total"
+    };
+
+    std::fprintf(file, "stage,count,p50_us,p99_us,p999_us,max_us\n");
+
+    for (unsigned int stage = 0; stage < KINECT_LATENCY_STAGES; stage++) {
+        LatencySummary summary = m_latency[stage].summary();
+        std::fprintf(file, "%s,%llu,%.1f,%.1f,%.1f,%.1f\n", names[stage],
+                     static_cast<unsigned long long>(summary.count),
+                     summary.p50 / 1000.0, summary.p99 / 1000.0,
+                     summary.p999 / 1000.0, summary.max / 1000.0);
+    }
+}
+
+void KinectCore::setPipelineDropPolicy(int dropPolicy) {
+    m_detectQueue.setDropPolicy(dropPolicy);
+    m_renderQueue.setDropPolicy(dropPolicy);
+    m_outputQueue.setDropPolicy(dropPolicy);
+}
+
+void KinectCore::setMouseTracking(bool on) {
+    m_moveMouse = on;
+}
+
+void KinectCore::enableColor(ProcColor color) {
+    if (!isEnabled(color)) {
+        m_enabledColors |= (1 << color);
+    }
+}
+
+void KinectCore::disableColor(ProcColor color) {
+    if (isEnabled(color)) {
+        m_enabledColors &= ~(1 << color);
+
+        std::lock_guard<std::mutex> lock(m_vidImageMutex);
+        m_calibFrames[color].reset();
+    }
+}
+
+bool KinectCore::isEnabled(ProcColor color) const {
+    return m_enabledColors & (1 << color);
+}
+
+void KinectCore::setScreenRect(CvRect screenRect) {
+    std::lock_guard<std::mutex> lock(m_quadMutex);
+    m_screenRect = screenRect;
+}
+
+void KinectCore::setLensCorrection(bool enable) {
+    std::lock_guard<std::mutex> lock(m_quadMutex);
+    m_lensCorrection = enable;
+}
+
+void KinectCore::setLensModel(const LensModel& lens) {
+    std::lock_guard<std::mutex> lock(m_quadMutex);
+    m_lens = lens;
+}
+
+void KinectCore::setMultiPointer(bool enable) {
+    m_multiPointer = enable;
+}
+
+void KinectCore::setBackgroundSuppression(bool enable) {
+    m_backgroundSuppression = enable;
+}
+
+void KinectCore::setPyramidLevel(int level) {
+    m_pyramidLevel = std::max(0, std::min(level, 2));
+}
+
+void KinectCore::setTouchDetection(bool enable) {
+    m_touchEnabled = enable;
+}
+
+void KinectCore::resetTouchSurface() {
+    // Applied by the depth stage before it processes its next frame
+    m_touchResetRequested = true;
+}
+
+void KinectCore::newVideoFrame(NStream<KinectCore>& streamObject, void* classObject) {
+    KinectCore* kntPtr = reinterpret_cast<KinectCore*>(classObject);
+
+    // Take a reference to the new frame instead of copying it
+    FrameRef frame = streamObject.getFrame();
+
+    {
+        std::lock_guard<std::mutex> lock(kntPtr->m_vidImageMutex);
+        kntPtr->m_vidFrame = frame;
+    }
+
+    // Only the stages due for a frame get it
+    uint64_t now = latencyClock();
+    bool track = kntPtr->m_foundScreen && kntPtr->m_trackPacer.take(now);
+    bool preview = kntPtr->m_previews && kntPtr->m_previewPacer.take(now);
+
+    if (!track && !preview) {
+        kntPtr->m_videoFramesPaced++;
+        return;
+    }
+
+    /* Hand the frame to the other stages. Only references are queued, so this
+     * never waits on processing.
+     */
+    if (track) {
+        kntPtr->m_detectQueue.push(frame);
+    }
+    if (preview) {
+        kntPtr->m_renderQueue.push(std::move(frame));
+    }
+}
+
+void KinectCore::newDepthFrame(NStream<KinectCore>& streamObject, void* classObject) {
+    KinectCore* kntPtr = reinterpret_cast<KinectCore*>(classObject);
+
+    uint64_t now = latencyClock();
+    bool touch = kntPtr->m_touchEnabled && kntPtr->m_touchPacer.take(now);
+    bool render = kntPtr->m_previews && kntPtr->m_depthPacer.take(now);
+
+    if (!touch && !render) {
+        kntPtr->m_depthFramesPaced++;
+        return;
+    }
+
+    /* The flags stay set until the stage gets to a frame, so one due
+     * consumer isn't lost if the stage is woken twice before it runs
+     */
+    if (touch) {
+        kntPtr->m_depthTouchDue = true;
+    }
+    if (render) {
+        kntPtr->m_depthRenderDue = true;
+    }
+
+    // The depth render stage picks the frame up from the triple buffer
+    kntPtr->m_depthRenderQueue.push(true);
+}
+
+void KinectCore::detectStage() {
+    FrameRef frame;
+
+    while (m_detectQueue.pop(frame)) {
+        detectCursors(frame);
+
+        // Return the frame to the pool while waiting for the next one
+        frame.reset();
+    }
+}
+
+void KinectCore::renderStage() {
+    FrameRef frame;
+
+    while (m_renderQueue.pop(frame)) {
+        renderVideo(frame);
+        frame.reset();
+    }
+}
+
+void KinectCore::depthRenderStage() {
+    bool newFrame;
+
+    while (m_depthRenderQueue.pop(newFrame)) {
+        // Swap in the newest depth frame
+        TripleBuffer& frames = *depth.triple;
+        if (!frames.update()) {
+            continue;
+        }
+        m_depthFramesMissed += frames.missed();
+
+        if (m_touchResetRequested.exchange(false)) {
+            m_touch.reset();
+        }
+
+        if (m_depthTouchDue.exchange(false) && m_touchEnabled) {
+            detectTouches(reinterpret_cast<uint16_t*>(frames.frontBuffer()));
+        }
+
+        if (m_depthRenderDue.exchange(false)) {
+            renderDepth();
+        }
+    }
+}
+
+void KinectCore::outputStage() {
+    std::vector<PointerEvent> batch;
+    batch.reserve(KINECT_OUTPUT_QUEUE);
+
+    // The newest event given to the sink
+    PointerEvent last;
+    bool haveLast = false;
+
+    /* Take everything queued while the sink was busy, so a slow sink gets
+     * fewer, larger batches instead of falling further behind
+     */
+    while (m_outputQueue.popAll(batch)) {
+        unsigned int queued = batch.size();
+        coalescePointerEvents(batch, haveLast ? &last : nullptr);
+        m_outputCoalesced += queued - batch.size();
+
+        if (batch.empty()) {
+            continue;
+        }
+
+        std::shared_ptr<PointerSink> sink;
+        {
+            std::lock_guard<std::mutex> lock(m_sinkMutex);
+            sink = m_sink;
+        }
+
+        if (sink != nullptr) {
+            sink->submit(batch.data(), batch.size());
+        }
+
+        for (const auto& event : batch) {
+            if (event.pointer) {
+                m_latency[KINECT_LATENCY_OUTPUT].recordSince(event.mappedTime);
+                m_latency[KINECT_LATENCY_TOTAL].recordSince(event.captureTime);
+            }
+        }
+
+        last = batch.back();
+        haveLast = true;
+    }
+}
+
+void KinectCore::detectCursors(const FrameRef& frame) {
+    // We can't look for cursors if we never found a screen on which to look
+    if (!m_foundScreen) {
+        return;
+    }
+
+    std::shared_ptr<const QuadSpans> spans;
+    Homography homography;
+    std::shared_ptr<const ScreenMap> screenMap;
+    CvRect screenRect;
+    {
+        std::lock_guard<std::mutex> lock(m_quadMutex);
+        spans = m_spans;
+        homography = m_homography;
+        screenMap = m_screenMap;
+        screenRect = m_screenRect;
+    }
+
+    // calibrate() builds the span table whenever it finds a screen
+    if (spans == nullptr) {
+        return;
+    }
+
+    if (spans != m_trackedSpans) {
+        m_tracker.reset();
+        m_contactTracker.reset();
+
+        // The calibration images would have taught it the screen is red
+        m_colorBackground.resize(m_imageSize);
+        m_colorBackground.reset();
+        m_coarseBackground.reset();
+
+        m_trackedSpans = spans;
+    }
+
+    bool multiPointer = m_multiPointer;
+    bool suppressBackground = m_backgroundSuppression;
+    int step = 1 << m_pyramidLevel;
+
+    /* Create a list of points which represent potential locations
+     * of the pointer. Only the part of the image covered by the screen is
+     * searched.
+     */
+    IplImage* tempImage = RGBtoIplImage(frame.data(),
+                                        ImageVars::width,
+                                        ImageVars::height,
+                                        m_workspace);
+
+    // Only candidates inside the screen can become pointers
+    auto keepInside = [&] {
+        m_plistRaw.erase(std::remove_if(m_plistRaw.begin(), m_plistRaw.end(),
+            [&](const CvPoint& point) {
+                return screenMap != nullptr ? !screenMap->contains(point) :
+                                              !spans->contains(point);
+            }), m_plistRaw.end());
+    };
+
+    /* Fills holds with a window around each pointer seen on the last frame,
+     * in a mask with one pixel per step pixels of the image. Nothing is
+     * learned there, so a pointer that's held still doesn't become
+     * background.
+     */
+    CvRect holds[CONTACT_MAX];
+    auto holdContacts = [&] {
+        unsigned int count = 0;
+        for (const auto& contact : m_contacts) {
+            if (contact.state != CONTACT_UP && count < CONTACT_MAX) {
+                holds[count++] = cvRect(
+                    (contact.point.x - TRACKER_WINDOW) / step,
+                    (contact.point.y - TRACKER_WINDOW) / step,
+                    2 * TRACKER_WINDOW / step + 1,
+                    2 * TRACKER_WINDOW / step + 1);
+            }
+        }
+
+        return count;
+    };
+
+    /* The predicted window only follows one pointer, so with several the
+     * whole screen is searched on every frame
+     */
+    bool searched = false;
+    if (!multiPointer && m_tracker.isTracking()) {
+        /* Look in the window the pointer is predicted to be in first. The
+         * whole screen is only searched again once it's lost.
+         */
+        CvRect window = m_tracker.predict(frame.captureTime(), m_imageSize);
+        spans->clip(window, m_windowSpans);
+        imageFilter(tempImage, m_workspace.mask, FLT_RED, m_windowSpans);
+        if (suppressBackground) {
+            // Don't let a pointer that's held still become background
+            m_colorBackground.apply(m_workspace.mask, m_windowSpans, window);
+        }
+        m_latency[KINECT_LATENCY_FILTER].recordSince(frame.captureTime());
+
+        uint64_t filterTime = latencyClock();
+        findMaskLocation(m_workspace.mask, m_workspace, m_plistRaw,
+                         &m_windowSpans);
+        keepInside();
+        m_latency[KINECT_LATENCY_CONTOURS].recordSince(filterTime);
+
+        if (m_plistRaw.empty()) {
+            m_tracker.miss();
+        }
+
+        // Still tracking means either it was found or it may turn up again
+        searched = !m_plistRaw.empty() || m_tracker.isTracking();
+    }
+
+    if (!searched && step > 1) {
+        // Find candidates with a fraction of the samples, then refine them
+        m_workspace.resizeCoarse(m_imageSize, step);
+        spans->decimate(step, m_workspace.coarseSpans);
+        imageFilterDecimated(tempImage, m_workspace.coarseMask, FLT_RED,
+                             m_workspace.coarseSpans, step);
+        if (suppressBackground) {
+            m_coarseBackground.resize(cvGetSize(m_workspace.coarseMask));
+            m_coarseBackground.apply(m_workspace.coarseMask,
+                                     m_workspace.coarseSpans, holds,
+                                     holdContacts());
+        }
+        m_latency[KINECT_LATENCY_FILTER].recordSince(frame.captureTime());
+
+        uint64_t filterTime = latencyClock();
+        refineMaskLocation(tempImage, FLT_RED, step, *spans, m_workspace,
+                           m_plistRaw);
+        keepInside();
+        m_latency[KINECT_LATENCY_CONTOURS].recordSince(filterTime);
+    }
+    else if (!searched) {
+        imageFilter(tempImage, m_workspace.mask, FLT_RED, *spans);
+        if (suppressBackground) {
+            m_colorBackground.apply(m_workspace.mask, *spans, holds,
+                                    holdContacts());
+        }
+        m_latency[KINECT_LATENCY_FILTER].recordSince(frame.captureTime());
+
+        uint64_t filterTime = latencyClock();
+        findMaskLocation(m_workspace.mask, m_workspace, m_plistRaw, spans.get());
+        keepInside();
+        m_latency[KINECT_LATENCY_CONTOURS].recordSince(filterTime);
+    }
+
+    if (!multiPointer && !m_plistRaw.empty()) {
+        // Only the candidate nearest the prediction becomes the pointer
+        int best = m_tracker.closest(m_plistRaw, frame.captureTime());
+        std::swap(m_plistRaw[0], m_plistRaw[best]);
+        m_plistRaw.resize(1);
+
+        m_tracker.update(m_plistRaw[0], frame.captureTime());
+    }
+
+    uint64_t contourTime = latencyClock();
+
+    // Give each pointer the same ID it had on the previous frames
+    m_contactTracker.update(m_plistRaw, frame.captureTime(), m_contacts);
+
+    if (m_contacts.empty() || !m_moveMouse) {
+        return;
+    }
+
+    // With touch detection on, the mouse follows touches instead
+    PointerEvent event;
+    mapContacts(m_contacts, m_plistProc, homography, screenMap.get(),
+                screenRect, !m_touchEnabled, event);
+    m_latency[KINECT_LATENCY_SCREEN].recordSince(contourTime);
+
+    event.timestamp = frame.timestamp();
+    event.captureTime = frame.captureTime();
+    event.mappedTime = latencyClock();
+
+    m_outputQueue.push(event);
+}
+
+void KinectCore::renderVideo(const FrameRef& frame) {
+    Quad quad;
+    {
+        std::lock_guard<std::mutex> lock(m_quadMutex);
+        quad = m_quad;
+    }
+
+    //                            B ,   G ,   R ,   A
+    CvScalar lineColor = cvScalar(0x00, 0xFF, 0x00, 0xFF);
+
+    /* Perform conversion from RGB to BGRA for use as image data in the
+     * preview. The frame is shared, so the lines are drawn on the copy.
+     */
+    cvSetData(&m_vidHeader, frame.data(), ImageVars::width * 3);
+    cvCvtColor(&m_vidHeader, m_cvBitmapDest, CV_RGB2BGRA);
+
+    if (m_foundScreen) {
+        // Draw lines to show user where the screen is
+        cvLine(m_cvBitmapDest, quad.point[0], quad.point[1], lineColor, 2, 8, 0);
+        cvLine(m_cvBitmapDest, quad.point[1], quad.point[2], lineColor, 2, 8, 0);
+        cvLine(m_cvBitmapDest, quad.point[2], quad.point[3], lineColor, 2, 8, 0);
+        cvLine(m_cvBitmapDest, quad.point[3], quad.point[0], lineColor, 2, 8, 0);
+    }
+
+    // newVideoFrame() only queues the frames the preview is due for
+    videoImage(m_cvBitmapDest);
+}
+
+void KinectCore::detectTouches(const uint16_t* depthFrame) {
+    // Latencies are measured from the moment the frame arrived
+    uint64_t captureTime = depth.triple->frontCaptureTime();
+
+    if (!m_foundScreen) {
+        return;
+    }
+
+    std::shared_ptr<const QuadSpans> spans;
+    Homography homography;
+    std::shared_ptr<const ScreenMap> screenMap;
+    CvRect screenRect;
+    {
+        std::lock_guard<std::mutex> lock(m_quadMutex);
+        spans = m_spans;
+        homography = m_homography;
+        screenMap = m_screenMap;
+        screenRect = m_screenRect;
+    }
+
+    if (spans == nullptr) {
+        return;
+    }
+
+    if (spans != m_touchSpans) {
+        m_touchTracker.reset();
+        m_touchSpans = spans;
+    }
+
+    /* The depth image isn't registered to the RGB image, so the screen found
+     * in the RGB image is used as-is. Both are 640x480 and the cameras sit
+     * next to each other, so this is off by a few pixels near the edges.
+     */
+    m_touchWorkspace.resize(m_imageSize);
+    m_touch.process(depthFrame, *spans,
+                    reinterpret_cast<uint8_t*>(m_touchWorkspace.mask->imageData),
+                    m_touchWorkspace.mask->widthStep);
+    findMaskLocation(m_touchWorkspace.mask, m_touchWorkspace, m_touchPoints,
+                     spans.get());
+
+    m_touchTracker.update(m_touchPoints, captureTime, m_touchContacts);
+    if (m_touchContacts.empty() || !m_moveMouse) {
+        return;
+    }
+
+    PointerEvent event;
+    mapContacts(m_touchContacts, m_touchPoints, homography, screenMap.get(),
+                screenRect, true, event);
+
+    event.timestamp = depth.triple->frontTimestamp();
+    event.captureTime = captureTime;
+    event.mappedTime = latencyClock();
+
+    m_outputQueue.push(event);
+}
+
+void KinectCore::renderDepth() {
+    TripleBuffer& frames = *depth.triple;
+
+    Quad quad;
+    {
+        std::lock_guard<std::mutex> lock(m_quadMutex);
+        quad = m_quad;
+    }
+
+    m_depthImageMutex.lock();
+
+    /* Convert the depth image straight from the stream buffer into BGRA
+     * (2 bytes per pixel in, 4 bytes per pixel out)
+     */
+    m_depthColorizer.colorize(
+        reinterpret_cast<uint16_t*>(frames.frontBuffer()),
+        reinterpret_cast<uint32_t*>(m_cvDepthImage->imageData),
+        ImageVars::width * ImageVars::height);
+
+    //                            B ,   G ,   R ,   A
+    CvScalar lineColor = cvScalar(0x00, 0xFF, 0x00, 0xFF);
+
+    if (m_foundScreen) {
+        // Draw lines to show user where the screen is
+        cvLine(m_cvDepthImage, quad.point[0], quad.point[1], lineColor, 2, 8, 0);
+        cvLine(m_cvDepthImage, quad.point[1], quad.point[2], lineColor, 2, 8, 0);
+        cvLine(m_cvDepthImage, quad.point[2], quad.point[3], lineColor, 2, 8, 0);
+        cvLine(m_cvDepthImage, quad.point[3], quad.point[0], lineColor, 2, 8, 0);
+    }
+
+    // newDepthFrame() only asks for the frames the display is due for
+    depthImage(m_cvDepthImage);
+
+    m_depthImageMutex.unlock();
+}
+
+void KinectCore::mapContacts(const std::vector<Contact>& contacts,
+                             std::vector<CvPoint>& points,
+                             const Homography& homography,
+                             const ScreenMap* screenMap, CvRect screenRect,
+                             bool moveMouse, PointerEvent& event) {
+    // Scale all of the pointers to the size of the screen in one batch
+    points.clear();
+    for (const auto& contact : contacts) {
+        points.push_back(contact.point);
+    }
+
+    if (screenMap != nullptr) {
+        screenMap->map(points.data(), points.data(), points.size(),
+                       screenRect.width, screenRect.height);
+    }
+    else {
+        homography.map(points.data(), points.data(), points.size(),
+                       screenRect.width, screenRect.height);
+    }
+
+    // ContactTracker never reports more than CONTACT_MAX, but don't trust it
+    unsigned int count = std::min<unsigned int>(contacts.size(), CONTACT_MAX);
+
+    for (unsigned int i = 0; i < count; i++) {
+        Contact& contact = event.contacts[event.contactCount++];
+        contact = contacts[i];
+        contact.point.x = static_cast<float>(POINTER_RANGE) *
+                          (screenRect.x + points[i].x) / screenRect.width;
+        contact.point.y = static_cast<float>(POINTER_RANGE) *
+                          (screenRect.y + points[i].y) / screenRect.height;
+
+        // The mouse follows the pointer that has been seen the longest
+        if (moveMouse && !event.pointer && contact.state != CONTACT_UP) {
+            event.x = contact.point.x;
+            event.y = contact.point.y;
+            event.pointer = true;
+        }
+    }
+}
+
+void KinectCore::streamEvent(int event) {
+}
+
+void KinectCore::videoImage(const IplImage* image) {
+}
+
+void KinectCore::depthImage(const IplImage* image) {
+}
+
+/*
+ * Callback called by libfreenect each time the buffer is filled with a
+ * new RGB frame
+ *
+ * dev: filled with a pointer the the freenect device
+ * rgb: pointer to the RGB buffer
+ * timestamp: POSIX timestamp of the buffer
+ */
+void KinectCore::rgb_cb(freenect_device* dev, void* rgbBuf, uint32_t timestamp) {
+    // Latencies are measured from the moment the frame arrives
+    uint64_t captureTime = latencyClock();
+
+    KinectCore& kntPtr = *static_cast<KinectCore*>(freenect_get_user(dev));
+
+    /* Do nothing if the stream isn't up */
+    if (kntPtr.rgb.state != NSTREAM_UP) {
+        return;
+    }
+
+    // Queue a copy for the recorder; the file is written on its own thread
+    if (kntPtr.m_recorder.isRecording()) {
+        kntPtr.m_recorder.push(RECORDING_VIDEO, kntPtr.rgb.writeBuffer(),
+                               kntPtr.rgb.bufSize, timestamp);
+    }
+
+    /* Hand the filled frame to consumers and give libfreenect a free one. If
+     * consumers still hold every frame in the pool, this one is dropped and
+     * its buffer is filled again.
+     */
+    bool published = kntPtr.rgb.commitFrame(timestamp, captureTime);
+    freenect_set_video_buffer(dev, kntPtr.rgb.writeBuffer());
+
+    if (!published) {
+        return;
+    }
+
+    /* call the new frame callback */
+    if (kntPtr.rgb.newFrame != nullptr) {
+        kntPtr.rgb.newFrame(kntPtr.rgb, kntPtr.rgb.callbackarg);
+    }
+}
+
+/*
+ * Callback called by libfreenect each time the buffer is filled with a
+ * new depth frame
+ *
+ * dev: filled with a pointer to the freenect device
+ * rgb: pointer to the depth buffer
+ * timestamp: POSIX timestamp of the buffer
+ */
+void KinectCore::depth_cb(freenect_device* dev, void* depthBuf, uint32_t timestamp) {
+    // Latencies are measured from the moment the frame arrives
+    uint64_t captureTime = latencyClock();
+
+    KinectCore& kntPtr = *static_cast<KinectCore*>(freenect_get_user(dev));
+
+    /* Do nothing if the stream isn't up */
+    if (kntPtr.depth.state != NSTREAM_UP) {
+        return;
+    }
+
+    // Queue a copy for the recorder; the file is written on its own thread
+    if (kntPtr.m_recorder.isRecording()) {
+        kntPtr.m_recorder.push(RECORDING_DEPTH, kntPtr.depth.writeBuffer(),
+                               kntPtr.depth.bufSize, timestamp);
+    }
+
+    /* Publish the frame without blocking */
+    kntPtr.depth.commitFrame(timestamp, captureTime);
+    freenect_set_depth_buffer(dev, kntPtr.depth.writeBuffer());
+
+    /* call the new frame callback */
+    if (kntPtr.depth.newFrame != nullptr) {
+        kntPtr.depth.newFrame(kntPtr.depth, kntPtr.depth.callbackarg);
+    }
+}
+
+/*
+ * User calls this to start an RGB or depth stream. Should be called
+ * through the NStream struct
+ *
+ * stream: The NStream handle of the stream to start.
+ */
+int KinectCore::startstream(NStream<KinectCore>& stream) {
+    /* You can't start a stream that's already started */
+    if (stream.state != NSTREAM_DOWN)
+        return 1;
+
+    bool& wanted = &stream == &rgb ? m_videoWanted : m_depthWanted;
+    bool& streaming = &stream == &rgb ? m_videoStreaming : m_depthStreaming;
+
+    {
+        std::unique_lock<std::mutex> lock(m_captureMutex);
+
+        // A device being closed has to be closed before it can be reopened
+        m_captureCond.wait(lock, [this] {
+            return m_captureState != KINECT_CAPTURE_STOPPING;
+        });
+
+        wanted = true;
+        m_captureCond.notify_all();
+
+        if (m_captureState == KINECT_CAPTURE_STOPPED) {
+            /* The main worker thread isn't running. A previous one may have
+             * exited without being joined; it doesn't need the lock to finish.
+             */
+            if (m_captureThread.joinable()) {
+                m_captureThread.join();
+            }
+
+            m_captureState = KINECT_CAPTURE_STARTING;
+            m_captureThread = std::thread(&KinectCore::threadmain, this);
+        }
+
+        /* Wait for the thread to start the stream's transfers. It gives up on
+         * the stream if they fail to start.
+         */
+        m_captureCond.wait(lock, [&] {
+            return m_captureState == KINECT_CAPTURE_STOPPED ||
+                   m_captureState == KINECT_CAPTURE_STOPPING ||
+                   (m_captureState == KINECT_CAPTURE_RUNNING &&
+                    streaming == wanted);
+        });
+
+        if (m_captureState != KINECT_CAPTURE_RUNNING || !streaming) {
+            /* the kinect failed to initialize */
+            return 1;
+        }
+    }
+
+    stream.state = NSTREAM_UP;
+
+    /* Do the callback */
+    if (stream.streamStarting != nullptr) {
+        stream.streamStarting(stream, stream.callbackarg);
+    }
+
+    return 0;
+}
+
+/*
+ * User calls this to stop the RGB stream. Note that RGB and depth streams
+ * have seperate stop functions, unlike start functions.
+ *
+ * stream: The NStream handle of the stream to stop.
+ */
+int KinectCore::rgb_stopstream() {
+    if (rgb.state != NSTREAM_UP)
+        return 1;
+
+    /* Stop its transfers. If we're servicing no other streams, this shuts
+     * down the thread.
+     */
+    setStreamWanted(rgb, false);
+
+    rgb.state = NSTREAM_DOWN;
+
+    /* Do the callback */
+    if (rgb.streamStopping != nullptr) {
+        rgb.streamStopping(rgb, rgb.callbackarg);
+    }
+
+    return 0;
+}
+
+/*
+ * User calls this to stop the depth stream. Note that depth and depth streams
+ * have seperate stop functions, unlike start functions.
+ *
+ * stream: The NStream handle of the stream to stop
+ */
+int KinectCore::depth_stopstream() {
+    if (depth.state != NSTREAM_UP)
+        return 1;
+
+    /* Stop its transfers. If we're servicing no other streams, this shuts
+     * down the thread.
+     */
+    setStreamWanted(depth, false);
+
+    depth.state = NSTREAM_DOWN;
+
+    /* Do the callback */
+    if (depth.streamStopping != nullptr) {
+        depth.streamStopping(depth, depth.callbackarg);
+    }
+
+    return 0;
+}
+
+void KinectCore::stopCapture() {
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+
+    if (m_captureState == KINECT_CAPTURE_STARTING ||
+            m_captureState == KINECT_CAPTURE_RUNNING) {
+        m_captureState = KINECT_CAPTURE_STOPPING;
+        m_captureCond.notify_all();
+    }
+}
+
+void KinectCore::setStreamWanted(const NStream<KinectCore>& stream, bool wanted) {
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+
+    if (&stream == &rgb) {
+        m_videoWanted = wanted;
+    }
+    else {
+        m_depthWanted = wanted;
+    }
+
+    if (!m_videoWanted && !m_depthWanted &&
+            (m_captureState == KINECT_CAPTURE_STARTING ||
+             m_captureState == KINECT_CAPTURE_RUNNING)) {
+        // We're servicing no streams, so close the device
+        m_captureState = KINECT_CAPTURE_STOPPING;
+    }
+
+    m_captureCond.notify_all();
+}
+
+void KinectCore::setCaptureState(int state) {
+    {
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        m_captureState = state;
+
+        // Nothing streams from a closed device
+        if (state == KINECT_CAPTURE_STOPPED) {
+            m_videoWanted = false;
+            m_depthWanted = false;
+            m_videoStreaming = false;
+            m_depthStreaming = false;
+        }
+    }
+    m_captureCond.notify_all();
+}
+
+/*
+ * Main thread function, opens the kinect, then starts and stops its streams
+ * as they're wanted until neither is or stopCapture() is called. USB events
+ * for every device are handled by the shared FreenectContext's thread, which
+ * also runs rgb_cb() and depth_cb().
+ */
+void KinectCore::threadmain() {
+    int error;
+    freenect_device *f_dev;
+
+    std::shared_ptr<FreenectContext> context = FreenectContext::get();
+    if (context == nullptr) {
+        setCaptureState(KINECT_CAPTURE_STOPPED);
+        return;
+    }
+
+    // If the context stops handling events, this device is as good as gone
+    error = context->openDevice(m_deviceIndex, m_deviceSerial,
+                                [this] { stopCapture(); }, &f_dev);
+    if (error != 0) {
+        if (m_deviceSerial.empty()) {
+            fprintf(stderr, "failed to open kinect %d of %d\n", m_deviceIndex,
+                    context->deviceCount());
+        }
+        else {
+            fprintf(stderr, "failed to open kinect %s\n",
+                    m_deviceSerial.c_str());
+        }
+        setCaptureState(KINECT_CAPTURE_STOPPED);
+        return;
+    }
+
+    freenect_set_user(f_dev, this);
+    freenect_set_video_callback(f_dev, rgb_cb);
+    freenect_set_depth_callback(f_dev, depth_cb);
+
+    error = freenect_set_video_mode(f_dev, freenect_find_video_mode(
+                                           FREENECT_RESOLUTION_MEDIUM,
+                                           FREENECT_VIDEO_RGB));
+    if (error != 0) {
+        fprintf(stderr, "failed to set video mode\n");
+        context->closeDevice(f_dev);
+        setCaptureState(KINECT_CAPTURE_STOPPED);
+        return;
+    }
+
+    error = freenect_set_depth_mode(f_dev, freenect_find_depth_mode(
+                                           FREENECT_RESOLUTION_MEDIUM,
+                                           FREENECT_DEPTH_11BIT));
+    if (error != 0) {
+        fprintf(stderr, "failed to set depth mode\n");
+        context->closeDevice(f_dev);
+        setCaptureState(KINECT_CAPTURE_STOPPED);
+        return;
+    }
+
+    error = freenect_set_video_buffer(f_dev, rgb.writeBuffer());
+    if (error != 0) {
+        fprintf(stderr, "failed to set video buffer\n");
+        context->closeDevice(f_dev);
+        setCaptureState(KINECT_CAPTURE_STOPPED);
+        return;
+    }
+
+    error = freenect_set_depth_buffer(f_dev, depth.writeBuffer());
+    if (error != 0) {
+        fprintf(stderr, "failed to set depth buffer\n");
+        context->closeDevice(f_dev);
+        setCaptureState(KINECT_CAPTURE_STOPPED);
+        return;
+    }
+
+    /* Turn the LED red */
+    freenect_set_led(f_dev, LED_RED);
+
+    bool videoStreaming = false;
+    bool depthStreaming = false;
+
+    std::unique_lock<std::mutex> lock(m_captureMutex);
+
+    // We initialized everything successfully, unless we were stopped
+    if (m_captureState == KINECT_CAPTURE_STARTING) {
+        m_captureState = KINECT_CAPTURE_RUNNING;
+        m_captureCond.notify_all();
+    }
+
+    /* Start and stop each stream's USB transfers as they're wanted, so an
+     * idle stream doesn't use any bandwidth or callbacks, until neither is
+     */
+    while (true) {
+        m_captureCond.wait(lock, [&] {
+            return m_captureState == KINECT_CAPTURE_STOPPING ||
+                   m_videoWanted != videoStreaming ||
+                   m_depthWanted != depthStreaming;
+        });
+
+        if (m_captureState == KINECT_CAPTURE_STOPPING) {
+            break;
+        }
+
+        bool wantVideo = m_videoWanted;
+        bool wantDepth = m_depthWanted;
+        lock.unlock();
+
+        if (wantVideo != videoStreaming) {
+            if (wantVideo) {
+                error = freenect_start_video(f_dev);
+                if (error != 0) {
+                    fprintf(stderr, "failed to start video stream\n");
+                }
+                videoStreaming = error == 0;
+            }
+            else {
+                freenect_stop_video(f_dev);
+                videoStreaming = false;
+            }
+        }
+
+        if (wantDepth != depthStreaming) {
+            if (wantDepth) {
+                error = freenect_start_depth(f_dev);
+                if (error != 0) {
+                    fprintf(stderr, "failed to start depth stream\n");
+                }
+                depthStreaming = error == 0;
+            }
+            else {
+                freenect_stop_depth(f_dev);
+                depthStreaming = false;
+            }
+        }
+
+        lock.lock();
+
+        // A stream that failed to start is given up on
+        if (wantVideo && !videoStreaming && m_videoWanted) {
+            m_videoWanted = false;
+        }
+        if (wantDepth && !depthStreaming && m_depthWanted) {
+            m_depthWanted = false;
+        }
+
+        m_videoStreaming = videoStreaming;
+        m_depthStreaming = depthStreaming;
+        m_captureCond.notify_all();
+
+        if (!m_videoWanted && !m_depthWanted) {
+            m_captureState = KINECT_CAPTURE_STOPPING;
+        }
+    }
+
+    lock.unlock();
+
+    /* Turn the LED blinking green */
+    freenect_set_led(f_dev, LED_BLINK_GREEN);
+
+    auto oldState = NSTREAM_UP;
+    // If this function was able to switch rgb's state from up to down
+    if (rgb.state.compare_exchange_strong(oldState, NSTREAM_DOWN)) {
+        // Call the callback
+        if (rgb.streamStopping != nullptr) {
+            rgb.streamStopping(rgb, rgb.callbackarg);
+        }
+    }
+    oldState = NSTREAM_UP;
+    // If this function was able to switch depth's state from up to down
+    if (depth.state.compare_exchange_strong(oldState, NSTREAM_DOWN)) {
+        // Call the callback
+        if (depth.streamStopping != nullptr) {
+            depth.streamStopping(depth, depth.callbackarg);
+        }
+    }
+
+    if (videoStreaming) {
+        freenect_stop_video(f_dev);
+    }
+    if (depthStreaming) {
+        freenect_stop_depth(f_dev);
+    }
+
+    context->closeDevice(f_dev);
+
+    setCaptureState(KINECT_CAPTURE_STOPPED);
+}
@@ -0,0 +1,566 @@
+//=============================================================================
+//File Name: KinectCore.hpp
+//Description: Captures from a Microsoft Kinect and tracks pointers in its
+//             images without depending on any windowing system
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * startVideoStream() must be called to start the image stream upon
+ * construction of the object. Frontends derive from KinectCore to show the
+ * previews (see the hooks at the end of the class), and give it a
+ * PointerSink to move the system's pointer; without one, it only tracks.
+ */
+
+#ifndef KINECT_CORE_HPP
+#define KINECT_CORE_HPP
+
+#include "ImageVars.hpp"
+#include "Processing.hpp"
+#include "DepthColorizer.hpp"
+#include "CKinect/Parse.hpp"
+#include "CKinect/PointerTracker.hpp"
+#include "CKinect/ContactTracker.hpp"
+#include "CKinect/ColorBackground.hpp"
+#include "CKinect/TouchDetector.hpp"
+#include "CKinect/NStream.hpp"
+#include "CKinect/FreenectContext.hpp"
+#include "CKinect/FrameQueue.hpp"
+#include "CKinect/PointerSink.hpp"
+#include "CKinect/TokenBucket.hpp"
+#include "CKinect/Recording.hpp"
+#include "CKinect/Replay.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+
+#include <libfreenect/libfreenect.h>
+#include <opencv2/core/core_c.h>
+
+// Stream events passed to streamEvent()
+#define KINECT_VIDEOSTART 0x0001
+#define KINECT_VIDEOSTOP  0x0002
+#define KINECT_DEPTHSTART 0x0003
+#define KINECT_DEPTHSTOP  0x0004
+
+// States of the thread that owns the device (see threadmain())
+#define KINECT_CAPTURE_STOPPED 0  // Not running; may still need joining
+#define KINECT_CAPTURE_STARTING 1 // Opening the device and starting streams
+#define KINECT_CAPTURE_RUNNING 2  // Streaming
+#define KINECT_CAPTURE_STOPPING 3 // Asked to stop; closing the device
+
+// Number of frames each pipeline stage may have queued
+#define KINECT_STAGE_QUEUE 2
+
+/* Number of events the output stage may have queued. Moves are coalesced
+ * when the sink falls behind, so this only has to hold the presses and
+ * releases that arrive meanwhile.
+ */
+#define KINECT_OUTPUT_QUEUE 16
+
+// Latency measurements (see getLatency())
+#define KINECT_LATENCY_FILTER 0   // rgb_cb entry to color mask done
+#define KINECT_LATENCY_CONTOURS 1 // Color mask to pointer candidates found
+#define KINECT_LATENCY_SCREEN 2   // Candidates to screen position
+#define KINECT_LATENCY_OUTPUT 3   // Screen position to PointerSink::submit() returned
+#define KINECT_LATENCY_TOTAL 4    // rgb_cb or depth_cb entry to submit() returned
+#define KINECT_LATENCY_STAGES 5
+
+// Frames dropped by each stage of the processing pipeline
+class PipelineStats {
+public:
+    unsigned int capture = 0; // No free frame in the video frame pool
+    unsigned int detect = 0;
+    unsigned int render = 0;
+    unsigned int depthRender = 0;
+    unsigned int output = 0;
+    unsigned int recording = 0; // The recorder's writer fell behind
+
+    // Output events dropped because newer ones made them redundant
+    unsigned int coalesced = 0;
+
+    // Frames skipped on purpose because no consumer was due for one
+    unsigned int pacedVideo = 0;
+    unsigned int pacedDepth = 0;
+};
+
+class KinectCore : public Processing {
+public:
+    /* Uses the Kinect at deviceIndex in the order libfreenect lists them.
+     * Every instance has its own streams and processing threads; they share
+     * one libfreenect context and USB event thread.
+     */
+    explicit KinectCore(int deviceIndex = 0);
+
+    // Uses the Kinect with the given serial number (see listDevices())
+    explicit KinectCore(const std::string& serial);
+
+    virtual ~KinectCore();
+
+    KinectCore(const KinectCore&) = delete;
+    KinectCore& operator=(const KinectCore&) = delete;
+
+    // Returns the serial numbers of the connected Kinects in index order
+    static std::vector<std::string> listDevices();
+
+    // Starts video stream from Kinect
+    void startVideoStream();
+
+    // Starts depth stream from Kinect
+    void startDepthStream();
+
+    // Stops video stream from Kinect
+    void stopVideoStream();
+
+    // Stops depth stream from Kinect
+    void stopDepthStream();
+
+    // Returns true if the RGB image stream is running
+    bool isVideoStreamRunning();
+
+    // Returns true if the depth image stream is running
+    bool isDepthStreamRunning();
+
+    /* Set max frame rate of the video preview. Frames the preview skips
+     * aren't converted for display. 0 means every frame; the default is 30.
+     */
+    void setVideoStreamFPS(unsigned int fps);
+
+    /* Set max frame rate of the depth image display. 0 means every frame;
+     * the default is 30.
+     */
+    void setDepthStreamFPS(unsigned int fps);
+
+    /* Set max rate at which frames are searched for pointers and touches,
+     * independently of the displays. 0, the default, means every frame.
+     */
+    void setTrackingFPS(unsigned int fps);
+
+    // Set range of depths (in meters) shown in color by the depth image
+    void setDepthRange(double minMeters, double maxMeters);
+
+    /* Sets where the output stage sends the pointers found. nullptr, the
+     * default, discards them. The sink is called from the output stage's
+     * thread only.
+     */
+    void setPointerSink(std::shared_ptr<PointerSink> sink);
+
+    /* Converts frames for the video and depth previews. Off by default, so
+     * nothing is drawn unless a frontend asks for it.
+     */
+    void setPreviews(bool enable);
+
+    // Saves most recently received RGB image to file
+    bool saveVideo(const std::string& fileName);
+
+    // Save most recently received depth image to file
+    bool saveDepth(const std::string& fileName);
+
+    /* Starts writing every raw RGB and depth frame received to the given file
+     * so the session can be replayed later
+     */
+    bool startRecording(const std::string& fileName);
+
+    // Finishes the recording started by startRecording()
+    bool stopRecording();
+
+    bool isRecording() const;
+
+    /* Plays back a recording made with startRecording() in place of the
+     * Kinect. Its frames take the same path as frames from the device, so
+     * calibration and tracking work as usual. pacing is REPLAY_ORIGINAL,
+     * REPLAY_FIXED_RATE (at fps) or REPLAY_MAX_SPEED. Fails if the device
+     * streams are running.
+     */
+    bool startReplay(const std::string& fileName,
+                     int pacing = REPLAY_ORIGINAL, double fps = 30.0,
+                     bool loop = false);
+
+    // Stops the replay and brings the streams it started down
+    void stopReplay();
+
+    // Returns true while a recording is being played back
+    bool isReplaying() const;
+
+    // Returns the rate the replay has published video frames at
+    double getReplayFPS() const;
+
+    // Stores current image as calibration image containing the given color
+    void setCalibImage(ProcColor colorWanted);
+
+    /* Processes calibration images stored in internal buffer to find location
+     * of screen
+     */
+    void calibrate();
+
+    /* Uses the given corners of the screen in the image instead of
+     * calibrating, for when no test pattern can be shown. Returns false if
+     * they don't make a quadrilateral that can be mapped onto the screen.
+     */
+    bool setScreenQuad(const CvPoint corners[4]);
+
+    /* Find points within screen boundary that could be mouse cursors and sets
+     * system mouse to match its location. The search runs on the detect stage
+     * using the most recently received image.
+     */
+    void lookForCursors();
+
+    // Returns the number of frames dropped by each pipeline stage so far
+    PipelineStats getPipelineStats() const;
+
+    /* Returns the latency percentiles measured for the given stage
+     * (KINECT_LATENCY_FILTER through KINECT_LATENCY_TOTAL)
+     */
+    LatencySummary getLatency(int stage) const;
+
+    // Discards the latencies measured so far
+    void resetLatency();
+
+    // Writes a table of every stage's latency percentiles to file
+    void dumpLatency(std::FILE* file) const;
+
+    /* Sets what the pipeline's queues do when a stage falls behind (either
+     * FRAMEQUEUE_DROP_OLDEST or FRAMEQUEUE_DROP_NEWEST)
+     */
+    void setPipelineDropPolicy(int dropPolicy);
+
+    // Turns mouse tracking on/off so user can regain control
+    void setMouseTracking(bool on);
+
+    // Adds color to calibration steps
+    void enableColor(ProcColor color);
+
+    // Removes color from calibration steps
+    void disableColor(ProcColor color);
+
+    // Returns true if there is a calibration image of the given color enabled
+    bool isEnabled(ProcColor color) const;
+
+    /* Give class the region of the screen being tracked so the mouse is moved
+     * on the correct monitor
+     */
+    void setScreenRect(CvRect screenRect);
+
+    /* Corrects for the distortion of the RGB camera's lens when mapping the
+     * pointer onto the screen, using a table built by calibrate(). Takes
+     * effect the next time calibrate() is called.
+     */
+    void setLensCorrection(bool enable);
+
+    // Replaces the default Kinect RGB lens model used for lens correction
+    void setLensModel(const LensModel& lens);
+
+    /* Follows every pointer on the screen instead of only one. The mouse
+     * follows the one that has been on the screen the longest.
+     */
+    void setMultiPointer(bool enable);
+
+    /* Ignores things that stay the pointer's color for a long time, like
+     * posters or clothing. Nothing is learned around the pointers found on
+     * the previous frame, so holding one still is fine, with or without
+     * setMultiPointer() and at any setPyramidLevel(). A pointer that isn't
+     * found on some frames can still fade after being held still for more
+     * than about 12 seconds, until it moves. On by default.
+     */
+    void setBackgroundSuppression(bool enable);
+
+    /* Searches the screen for pointers in the image shrunk by 2^level
+     * (level 1 or 2), then finds their centers at full resolution. Much
+     * cheaper, but pointers have to be several times 2^level pixels across to
+     * be found. 0, the default, searches at full resolution.
+     */
+    void setPyramidLevel(int level);
+
+    /* Finds fingers touching the screen in the depth image and moves the
+     * mouse with them like a pointer. While it's on, the mouse only follows
+     * touches; color pointers are still reported as contacts. The depth
+     * stream must be running. The surface is learned over the first frames,
+     * so nothing should be in front of it when this is turned on.
+     */
+    void setTouchDetection(bool enable);
+
+    // Relearns the surface touches are detected against
+    void resetTouchSurface();
+
+protected:
+    std::mutex m_vidImageMutex;
+    std::mutex m_depthImageMutex;
+
+    CvSize m_imageSize;
+
+    std::atomic<bool> m_foundScreen{false};
+
+    /* Stops capture and every pipeline stage, and waits for their threads to
+     * exit. Frontends call it first thing in their destructor so none of the
+     * hooks below runs while they're being destroyed; the destructor calls it
+     * again, which does nothing.
+     */
+    void shutdown();
+
+    /* Called with KINECT_VIDEOSTART through KINECT_DEPTHSTOP when a stream
+     * starts or stops. Runs on whichever thread started or stopped it.
+     */
+    virtual void streamEvent(int event);
+
+    /* Called by the render stage with the newest video frame in BGRA, with the
+     * screen outlined on it. Only called while previews are on.
+     */
+    virtual void videoImage(const IplImage* image);
+
+    /* Called by the depth render stage with the newest colorized depth frame,
+     * with the screen outlined on it. Only called while previews are on.
+     */
+    virtual void depthImage(const IplImage* image);
+
+    // Called when a new video image is received (swaps the image buffer)
+    static void newVideoFrame(NStream<KinectCore>& streamObject, void* classObject);
+
+    // Called when a new depth image is received (swaps the image buffer)
+    static void newDepthFrame(NStream<KinectCore>& streamObject, void* classObject);
+
+private:
+    CvRect m_screenRect;
+
+    // Converts raw depth images to BGRA for display
+    DepthColorizer m_depthColorizer;
+
+    // Newest video frame (shared with the stream's frame pool)
+    FrameRef m_vidFrame;
+
+    // OpenCV variables
+    IplImage* m_cvDepthImage;
+    IplImage* m_cvBitmapDest;
+
+    // Wraps m_vidFrame for drawing without copying it
+    IplImage m_vidHeader;
+
+    /* Calibration frames, held by reference until the next call to
+     * setCalibImage() for the same color
+     */
+    FrameRef m_calibFrames[ProcColor::Size];
+    IplImage m_calibHeaders[ProcColor::Size];
+
+    // Stores which colored images to include in calibration
+    char m_enabledColors = 0x00;
+
+    // Used for mouse tracking
+    std::atomic<bool> m_moveMouse{true};
+
+    // Whether the render stages convert frames for the previews
+    std::atomic<bool> m_previews{false};
+
+    /* Protects m_quad, m_spans, m_homography, the lens correction settings
+     * and m_screenRect
+     */
+    std::mutex m_quadMutex;
+    Quad m_quad;
+
+    // Maps points inside m_quad onto the screen
+    Homography m_homography;
+
+    // Lens-corrected replacement for m_homography, if enabled
+    bool m_lensCorrection = false;
+    LensModel m_lens = LensModel::kinectRGB();
+    std::shared_ptr<const ScreenMap> m_screenMap;
+
+    /* Rows of the image covered by m_quad. Replaced rather than modified when
+     * the screen is recalibrated, so the detect stage can keep using the one
+     * it copied.
+     */
+    std::shared_ptr<const QuadSpans> m_spans;
+    std::vector<CvPoint> m_plistRaw;
+    std::vector<CvPoint> m_plistProc;
+
+    // Scratch images and contour storage reused by the detect stage
+    FilterWorkspace m_workspace;
+
+    /* Follows the pointer between frames so the detect stage only has to
+     * search a window around it. m_trackedSpans is the screen the tracker's
+     * positions are relative to; it's reset when the screen is recalibrated.
+     */
+    PointerTracker m_tracker;
+    std::shared_ptr<const QuadSpans> m_trackedSpans;
+    QuadSpans m_windowSpans;
+
+    // Gives the pointers IDs that stay the same from frame to frame
+    std::atomic<bool> m_multiPointer{false};
+    ContactTracker m_contactTracker;
+    std::vector<Contact> m_contacts;
+
+    // Learns the static parts of the color mask; owned by the detect stage
+    std::atomic<bool> m_backgroundSuppression{true};
+    ColorBackground m_colorBackground;
+
+    // Coarse-to-fine search; the background is learned on the coarse mask
+    std::atomic<int> m_pyramidLevel{0};
+    ColorBackground m_coarseBackground;
+
+    // Touch detection, run by the depth render stage
+    std::atomic<bool> m_touchEnabled{false};
+    std::atomic<bool> m_touchResetRequested{false};
+    TouchDetector m_touch{640, 480};
+    FilterWorkspace m_touchWorkspace;
+
+    /* Touches are numbered apart from the color pointers, so the output
+     * stage never mistakes one for the other
+     */
+    ContactTracker m_touchTracker{CONTACT_ID_SPACE};
+    std::shared_ptr<const QuadSpans> m_touchSpans;
+    std::vector<CvPoint> m_touchPoints;
+    std::vector<Contact> m_touchContacts;
+
+    /* Pace each consumer of the streams separately. Frames are only queued
+     * for the consumers with a token, and dropped if none of them has one.
+     * Tokens are taken by the capture callbacks.
+     */
+    TokenBucket m_trackPacer;
+    TokenBucket m_touchPacer;
+    TokenBucket m_previewPacer{30};
+    TokenBucket m_depthPacer{30};
+
+    // Which consumers of the newest depth frame are due for it
+    std::atomic<bool> m_depthTouchDue{false};
+    std::atomic<bool> m_depthRenderDue{false};
+
+    std::atomic<unsigned int> m_videoFramesPaced{0};
+    std::atomic<unsigned int> m_depthFramesPaced{0};
+
+    /* Processing pipeline. The capture callbacks only queue frames; detection,
+     * drawing and mouse output each run on their own thread:
+     *   rgb_cb -> detect -> output
+     *   rgb_cb -> render
+     *   depth_cb -> depth render (and touch detection) -> output
+     */
+    FrameQueue<FrameRef> m_detectQueue{KINECT_STAGE_QUEUE};
+    FrameQueue<FrameRef> m_renderQueue{KINECT_STAGE_QUEUE};
+    FrameQueue<PointerEvent> m_outputQueue{KINECT_OUTPUT_QUEUE};
+
+    // test/PointerSinkTest.cpp feeds m_outputQueue directly
+    friend class PointerSinkTest;
+
+    // Receives the output stage's batches; protected by m_sinkMutex
+    std::mutex m_sinkMutex;
+    std::shared_ptr<PointerSink> m_sink;
+    std::atomic<unsigned int> m_outputCoalesced{0};
+
+    // Wakes the depth render stage (the frame itself is in depth.triple)
+    FrameQueue<bool> m_depthRenderQueue{1};
+
+    // Writes raw frames from the capture callbacks to disk
+    Recorder m_recorder;
+
+    // Latency from the USB callback through each detection step
+    LatencyHistogram m_latency[KINECT_LATENCY_STAGES];
+
+    /* Depth frames the depth render stage never saw, including the ones it
+     * wasn't woken for because of pacing
+     */
+    std::atomic<unsigned int> m_depthFramesMissed{0};
+
+    std::thread m_detectThread;
+    std::thread m_renderThread;
+    std::thread m_depthRenderThread;
+    std::thread m_outputThread;
+
+    void detectStage();
+    void renderStage();
+    void depthRenderStage();
+    void outputStage();
+
+    // Finds the cursor in the given frame and queues the new mouse position
+    void detectCursors(const FrameRef& frame);
+
+    // test/AllocationTest.cpp runs detectCursors() on frames it draws itself
+    friend class AllocationTest;
+
+    // Converts the frame to BGRA for the video preview
+    void renderVideo(const FrameRef& frame);
+
+    // Finds fingers touching the screen and queues them like pointers
+    void detectTouches(const uint16_t* depthFrame);
+
+    /* Converts the depth frame swapped in by the depth render stage to BGRA
+     * for the depth preview
+     */
+    void renderDepth();
+
+    /* Builds the mapping onto the screen for quad (as found by
+     * findScreenBox()) and starts tracking inside it if it's valid
+     */
+    void setQuad(Quad quad);
+
+    /* Maps the pointers found in the image onto the screen and fills event
+     * with them. points is overwritten with their screen positions. The mouse
+     * only follows them if moveMouse is true.
+     */
+    void mapContacts(const std::vector<Contact>& contacts,
+                     std::vector<CvPoint>& points, const Homography& homography,
+                     const ScreenMap* screenMap, CvRect screenRect,
+                     bool moveMouse, PointerEvent& event);
+
+    /* Video frames are handed to consumers by reference. The pool has room for
+     * the frame being filled, the newest one, the queued frames and one held
+     * by each stage, and one per calibration color.
+     */
+    NStream<KinectCore> rgb{640, 480, 3, &KinectCore::startstream, &KinectCore::rgb_stopstream, this, NSTREAM_POOLED, 12};
+    // Depth frames go through a triple buffer so the USB thread never waits
+    NStream<KinectCore> depth{640, 480, 2, &KinectCore::startstream, &KinectCore::depth_stopstream, this, NSTREAM_TRIPLE};
+
+    // Feeds rgb and depth from a recording instead of the device
+    ReplaySource<KinectCore> m_replay{rgb, depth};
+
+    // Which device to open; by serial number if m_deviceSerial isn't empty
+    int m_deviceIndex;
+    std::string m_deviceSerial;
+
+    // test/CaptureTest.cpp checks the capture state below directly
+    friend class CaptureTest;
+
+    /* Runs threadmain(). Every change of m_captureState is made under
+     * m_captureMutex and signaled on m_captureCond, so starting and stopping
+     * never poll. The state can be read without the lock.
+     */
+    std::thread m_captureThread;
+    std::atomic<int> m_captureState{KINECT_CAPTURE_STOPPED};
+    std::mutex m_captureMutex;
+    std::condition_variable m_captureCond;
+
+    /* Streams that are wanted, and the ones threadmain() has started USB
+     * transfers for. Protected by m_captureMutex.
+     */
+    bool m_videoWanted = false;
+    bool m_depthWanted = false;
+    bool m_videoStreaming = false;
+    bool m_depthStreaming = false;
+
+    /* Asks threadmain() to stop the streams and close the device without
+     * waiting for it, so it's safe to call from the device's callbacks
+     */
+    void stopCapture();
+
+    /* Asks threadmain() to start or stop the USB transfers of one stream.
+     * Once neither stream is wanted the device is closed. Doesn't wait, so
+     * it's safe to call from the device's callbacks.
+     */
+    void setStreamWanted(const NStream<KinectCore>& stream, bool wanted);
+
+    /* Sets m_captureState and wakes everything waiting for it to change.
+     * Stopping also forgets which streams were wanted.
+     */
+    void setCaptureState(int state);
+
+    static void rgb_cb(freenect_device* dev, void* rgbBuf, uint32_t timestamp);
+    static void depth_cb(freenect_device* dev, void* depthBuf, uint32_t timestamp);
+    int startstream(NStream<KinectCore>& stream);
+    int rgb_stopstream();
+    int depth_stopstream();
+    void threadmain();
+};
+
+#endif // KINECT_CORE_HPP
@@ -0,0 +1,34 @@
+//=============================================================================
+//File Name: SendInputSink.cpp
+//Description: Moves the Windows mouse cursor to the pointers found by the
+//             Kinect using SendInput()
+//Author: Tyler Veness
+//=============================================================================
+
+#include "SendInputSink.hpp"
+
+int SendInputSink::submit(const PointerEvent* events, unsigned int count) {
+    m_inputs.clear();
+
+    for (unsigned int i = 0; i < count; i++) {
+        if (!events[i].pointer) {
+            continue;
+        }
+
+        INPUT input;
+        ZeroMemory(&input, sizeof(INPUT));
+        input.type = INPUT_MOUSE;
+        input.mi.dx = events[i].x;
+        input.mi.dy = events[i].y;
+        input.mi.dwFlags = MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_MOVE;
+        m_inputs.push_back(input);
+    }
+
+    if (m_inputs.empty()) {
+        return 0;
+    }
+
+    // SendInput() returns how many inputs it inserted
+    UINT sent = SendInput(m_inputs.size(), m_inputs.data(), sizeof(INPUT));
+    return sent == m_inputs.size() ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+//=============================================================================
+//File Name: SendInputSink.hpp
+//Description: Moves the Windows mouse cursor to the pointers found by the
+//             Kinect using SendInput()
+//Author: Tyler Veness
+//=============================================================================
+
+#ifndef SEND_INPUT_SINK_HPP
+#define SEND_INPUT_SINK_HPP
+
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0501
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <vector>
+
+#include "CKinect/PointerSink.hpp"
+
+class SendInputSink : public PointerSink {
+public:
+    /* Moves the mouse to the pointer of every event in the batch with one
+     * call to SendInput(), so the moves can't be interleaved with other input
+     */
+    int submit(const PointerEvent* events, unsigned int count) override;
+
+private:
+    // Reused for every batch so submitting doesn't allocate
+    std::vector<INPUT> m_inputs;
+};
+
+#endif // SEND_INPUT_SINK_HPP
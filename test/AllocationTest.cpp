@@ -0,0 +1,167 @@
+//=============================================================================
+//File Name: AllocationTest.cpp
+//Description: Checks that KinectCore's detection path run on every frame
+//             doesn't allocate once its workspace has warmed up
+//Author: Tyler Veness
+//=============================================================================
+
+#include <random>
+
+#include <opencv2/imgproc/imgproc_c.h>
+
+#include "Test.hpp"
+#include "../bench/AllocationCount.hpp"
+#include "../src/KinectCore.hpp"
+#include "../src/CKinect/FramePool.hpp"
+
+// Frames drawn for each pass of a pointer across the screen
+#define ALLOCATION_TEST_FRAMES 8
+
+// Passes over the frames measured for each setting
+#define ALLOCATION_TEST_ROUNDS 4
+
+// Time between frames, as from a Kinect at 30 fps (nanoseconds)
+#define ALLOCATION_TEST_PERIOD 33333333
+
+class AllocationTest {
+public:
+    static void run();
+
+private:
+    /* Draws dark noise with the given number of red pointers moving across
+     * the screen into each frame of pool. The frames are drawn up front,
+     * since drawing allocates.
+     */
+    static void drawFrames(FramePool& pool, FrameRef* frames, int pointers);
+
+    /* Runs KinectCore::detectCursors() over the frames forward and back, so
+     * the pointers never jump, and returns how many times it found all of
+     * them
+     */
+    static unsigned int detect(KinectCore& kinect, FrameRef* frames,
+                               int pointers, uint64_t& captureTime);
+};
+
+void AllocationTest::drawFrames(FramePool& pool, FrameRef* frames,
+                                int pointers) {
+    const CvSize size = {640, 480};
+
+    std::mt19937 rng(1);
+    for (int i = 0; i < ALLOCATION_TEST_FRAMES; i++) {
+        frames[i] = pool.acquire();
+
+        uint8_t* data = frames[i].data();
+        for (size_t j = 0; j < pool.frameSize(); j++) {
+            data[j] = rng() & 0x3f;
+        }
+
+        IplImage header;
+        cvInitImageHeader(&header, size, IPL_DEPTH_8U, 3);
+        cvSetData(&header, data, size.width * 3);
+
+        // Frames are in the Kinect's R, G, B order
+        cvCircle(&header, cvPoint(200 + 20 * i, 240 + 5 * i), 8,
+                 cvScalar(230, 20, 30), -1, 8, 0);
+        if (pointers > 1) {
+            cvCircle(&header, cvPoint(420 - 20 * i, 150 + 5 * i), 8,
+                     cvScalar(230, 20, 30), -1, 8, 0);
+        }
+    }
+}
+
+unsigned int AllocationTest::detect(KinectCore& kinect, FrameRef* frames,
+                                    int pointers, uint64_t& captureTime) {
+    unsigned int found = 0;
+
+    for (int i = 0; i < 2 * ALLOCATION_TEST_FRAMES; i++) {
+        int index = i < ALLOCATION_TEST_FRAMES ?
+                    i : 2 * ALLOCATION_TEST_FRAMES - 1 - i;
+
+        captureTime += ALLOCATION_TEST_PERIOD;
+        frames[index].setCaptureTime(captureTime);
+        kinect.detectCursors(frames[index]);
+
+        int seen = 0;
+        for (const auto& contact : kinect.m_contacts) {
+            if (contact.state != CONTACT_UP) {
+                seen++;
+            }
+        }
+        if (seen == pointers) {
+            found++;
+        }
+    }
+
+    return found;
+}
+
+void AllocationTest::run() {
+    KinectCore kinect;
+
+    // A slightly skewed screen, as seen from a Kinect off to one side
+    Quad quad;
+    quad.point[0] = cvPoint(128, 96);
+    quad.point[1] = cvPoint(512, 106);
+    quad.point[2] = cvPoint(499, 384);
+    quad.point[3] = cvPoint(141, 374);
+    quad.validQuad = true;
+    kinect.setQuad(quad);
+    kinect.setScreenRect(cvRect(0, 0, 1920, 1080));
+    TEST_CHECK(kinect.m_foundScreen);
+
+    FramePool pool(640 * 480 * 3, 2 * ALLOCATION_TEST_FRAMES);
+    FrameRef singleFrames[ALLOCATION_TEST_FRAMES];
+    FrameRef multiFrames[ALLOCATION_TEST_FRAMES];
+    drawFrames(pool, singleFrames, 1);
+    drawFrames(pool, multiFrames, 2);
+
+    /* The single pointer is searched for in a window around it, and the
+     * other settings search the whole screen, at full resolution or
+     * coarse-to-fine
+     */
+    struct Setting {
+        bool multiPointer;
+        int pyramidLevel;
+    };
+    const Setting settings[] = {
+        {false, 0}, {true, 0},
+        {false, 1}, {true, 1},
+        {false, 2}, {true, 2}
+    };
+
+    uint64_t captureTime = latencyClock();
+    for (const auto& setting : settings) {
+        kinect.setMultiPointer(setting.multiPointer);
+        kinect.setPyramidLevel(setting.pyramidLevel);
+
+        int pointers = setting.multiPointer ? 2 : 1;
+        FrameRef* frames = setting.multiPointer ? multiFrames : singleFrames;
+
+        // The first frames size the workspace, the point lists and the models
+        kinect.m_tracker.reset();
+        detect(kinect, frames, pointers, captureTime);
+        detect(kinect, frames, pointers, captureTime);
+
+        unsigned int found = 0;
+        uint64_t allocations = allocationCount();
+        for (int round = 0; round < ALLOCATION_TEST_ROUNDS; round++) {
+            /* Lose the single pointer so it's searched for over the whole
+             * screen first, then followed in its window
+             */
+            kinect.m_tracker.reset();
+            found += detect(kinect, frames, pointers, captureTime);
+        }
+        allocations = allocationCount() - allocations;
+
+        TEST_CHECK(found ==
+                   ALLOCATION_TEST_ROUNDS * 2 * ALLOCATION_TEST_FRAMES);
+        TEST_CHECK(allocations == 0);
+        TEST_CHECK(setting.multiPointer || kinect.m_tracker.isTracking());
+    }
+
+    kinect.shutdown();
+}
+
+void allocationTest() {
+    AllocationTest::run();
+}
@@ -0,0 +1,122 @@
+//=============================================================================
+//File Name: CaptureTest.cpp
+//Description: Starts and stops KinectCore's streams thousands of times against
+//             the libfreenect stand-in, checking that capture never deadlocks
+//             and always ends up stopped
+//Author: Tyler Veness
+//=============================================================================
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <thread>
+
+#include "Test.hpp"
+#include "FakeFreenect.hpp"
+#include "../src/KinectCore.hpp"
+
+// Start and stop cycles per stream in each part of the test
+#define CAPTURE_TEST_CYCLES 2000
+
+// Longest any part of the test may take before it's taken to be deadlocked
+#define CAPTURE_TEST_TIMEOUT std::chrono::seconds(60)
+
+class CaptureTest {
+public:
+    static void run();
+
+private:
+    /* Runs func on its own thread. A deadlock can't be recovered from, so if
+     * func doesn't return within CAPTURE_TEST_TIMEOUT, the whole test
+     * executable exits with a failure.
+     */
+    static void runWithTimeout(const char* name, std::function<void()> func);
+
+    // Waits for the capture thread to close the device
+    static bool waitForStopped(KinectCore& kinect);
+};
+
+void CaptureTest::runWithTimeout(const char* name,
+                                 std::function<void()> func) {
+    auto done = std::async(std::launch::async, func);
+
+    if (done.wait_for(CAPTURE_TEST_TIMEOUT) != std::future_status::ready) {
+        std::printf("%s: deadlocked after %lld s\n", name,
+                    static_cast<long long>(CAPTURE_TEST_TIMEOUT.count()));
+        std::fflush(stdout);
+        std::_Exit(1);
+    }
+}
+
+bool CaptureTest::waitForStopped(KinectCore& kinect) {
+    std::unique_lock<std::mutex> lock(kinect.m_captureMutex);
+    return kinect.m_captureCond.wait_for(lock, CAPTURE_TEST_TIMEOUT, [&] {
+        return kinect.m_captureState == KINECT_CAPTURE_STOPPED;
+    });
+}
+
+void CaptureTest::run() {
+    KinectCore kinect;
+
+    // One stream at a time, then both overlapping, from one thread
+    runWithTimeout("capture cycles", [&] {
+        for (int i = 0; i < CAPTURE_TEST_CYCLES; i++) {
+            kinect.startVideoStream();
+            kinect.stopVideoStream();
+
+            kinect.startDepthStream();
+            kinect.stopDepthStream();
+
+            kinect.startVideoStream();
+            kinect.startDepthStream();
+            kinect.stopVideoStream();
+            kinect.stopDepthStream();
+        }
+    });
+
+    TEST_CHECK(waitForStopped(kinect));
+    TEST_CHECK(!kinect.isVideoStreamRunning());
+    TEST_CHECK(!kinect.isDepthStreamRunning());
+
+    // Each stream cycled from its own thread
+    runWithTimeout("capture cycles from two threads", [&] {
+        std::thread video([&] {
+            for (int i = 0; i < CAPTURE_TEST_CYCLES; i++) {
+                kinect.startVideoStream();
+                kinect.stopVideoStream();
+            }
+        });
+        std::thread depth([&] {
+            for (int i = 0; i < CAPTURE_TEST_CYCLES; i++) {
+                kinect.startDepthStream();
+                kinect.stopDepthStream();
+            }
+        });
+
+        video.join();
+        depth.join();
+    });
+
+    TEST_CHECK(waitForStopped(kinect));
+    TEST_CHECK(kinect.m_captureState == KINECT_CAPTURE_STOPPED);
+    TEST_CHECK(!kinect.isVideoStreamRunning());
+    TEST_CHECK(!kinect.isDepthStreamRunning());
+
+    // Stopping capture with a stream still running
+    runWithTimeout("capture shutdown", [&] {
+        kinect.startVideoStream();
+        kinect.startDepthStream();
+        kinect.shutdown();
+    });
+
+    TEST_CHECK(kinect.m_captureState == KINECT_CAPTURE_STOPPED);
+    TEST_CHECK(!kinect.m_captureThread.joinable());
+    TEST_CHECK(fakeFreenectOpenDevices() == 0);
+    TEST_CHECK(fakeFreenectContexts() == 0);
+}
+
+void captureTest() {
+    CaptureTest::run();
+}
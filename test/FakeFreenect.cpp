@@ -0,0 +1,262 @@
+//=============================================================================
+//File Name: FakeFreenect.cpp
+//Description: Stands in for libfreenect so KinectCore can be tested without a
+//             Kinect
+//Author: Tyler Veness
+//=============================================================================
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include <libfreenect/libfreenect.h>
+
+#include "FakeFreenect.hpp"
+
+static std::atomic<int> gOpenDevices{0};
+static std::atomic<int> gContexts{0};
+
+struct _freenect_context {
+    /* Held while frames are delivered, so a stream that's stopped or a
+     * device that's closed gets no callbacks once that returns
+     */
+    std::mutex mutex;
+    std::vector<freenect_device*> devices;
+};
+
+struct _freenect_device {
+    freenect_context* context;
+    void* user = nullptr;
+
+    freenect_video_cb videoCallback = nullptr;
+    freenect_depth_cb depthCallback = nullptr;
+
+    // Set from the callbacks, which run with the context's mutex held
+    std::atomic<void*> videoBuffer{nullptr};
+    std::atomic<void*> depthBuffer{nullptr};
+
+    bool videoStarted = false;
+    bool depthStarted = false;
+    uint32_t timestamp = 0;
+};
+
+int fakeFreenectOpenDevices() {
+    return gOpenDevices;
+}
+
+int fakeFreenectContexts() {
+    return gContexts;
+}
+
+int freenect_init(freenect_context** ctx, freenect_usb_context* usb_ctx) {
+    *ctx = new freenect_context;
+    gContexts++;
+
+    return 0;
+}
+
+int freenect_shutdown(freenect_context* ctx) {
+    delete ctx;
+    gContexts--;
+
+    return 0;
+}
+
+int freenect_num_devices(freenect_context* ctx) {
+    return 1;
+}
+
+int freenect_list_device_attributes(freenect_context* ctx,
+        struct freenect_device_attributes** attribute_list) {
+    auto attributes = new freenect_device_attributes;
+    std::memset(attributes, 0, sizeof(*attributes));
+    attributes->camera_serial = FAKE_FREENECT_SERIAL;
+
+    *attribute_list = attributes;
+
+    return 1;
+}
+
+void freenect_free_device_attributes(
+        struct freenect_device_attributes* attribute_list) {
+    delete attribute_list;
+}
+
+int freenect_open_device(freenect_context* ctx, freenect_device** dev,
+                         int index) {
+    if (index != 0) {
+        return -1;
+    }
+
+    auto device = new freenect_device;
+    device->context = ctx;
+    {
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        ctx->devices.push_back(device);
+    }
+    gOpenDevices++;
+
+    *dev = device;
+
+    return 0;
+}
+
+int freenect_open_device_by_camera_serial(freenect_context* ctx,
+                                          freenect_device** dev,
+                                          const char* camera_serial) {
+    if (std::strcmp(camera_serial, FAKE_FREENECT_SERIAL) != 0) {
+        return -1;
+    }
+
+    return freenect_open_device(ctx, dev, 0);
+}
+
+int freenect_close_device(freenect_device* dev) {
+    freenect_context* ctx = dev->context;
+    {
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        ctx->devices.erase(std::remove(ctx->devices.begin(),
+                                       ctx->devices.end(), dev),
+                           ctx->devices.end());
+    }
+    delete dev;
+    gOpenDevices--;
+
+    return 0;
+}
+
+int freenect_process_events_timeout(freenect_context* ctx,
+                                    struct timeval* timeout) {
+    // Frames arrive much faster than a Kinect sends them
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::lock_guard<std::mutex> lock(ctx->mutex);
+    for (auto device : ctx->devices) {
+        device->timestamp++;
+
+        if (device->videoStarted && device->videoCallback != nullptr) {
+            device->videoCallback(device, device->videoBuffer,
+                                  device->timestamp);
+        }
+        if (device->depthStarted && device->depthCallback != nullptr) {
+            device->depthCallback(device, device->depthBuffer,
+                                  device->timestamp);
+        }
+    }
+
+    return 0;
+}
+
+void freenect_set_user(freenect_device* dev, void* user) {
+    dev->user = user;
+}
+
+void* freenect_get_user(freenect_device* dev) {
+    return dev->user;
+}
+
+void freenect_set_video_callback(freenect_device* dev, freenect_video_cb cb) {
+    std::lock_guard<std::mutex> lock(dev->context->mutex);
+    dev->videoCallback = cb;
+}
+
+void freenect_set_depth_callback(freenect_device* dev, freenect_depth_cb cb) {
+    std::lock_guard<std::mutex> lock(dev->context->mutex);
+    dev->depthCallback = cb;
+}
+
+freenect_frame_mode freenect_find_video_mode(freenect_resolution res,
+                                             freenect_video_format fmt) {
+    freenect_frame_mode mode;
+    std::memset(&mode, 0, sizeof(mode));
+    mode.resolution = res;
+    mode.video_format = fmt;
+    mode.is_valid = 1;
+
+    return mode;
+}
+
+freenect_frame_mode freenect_find_depth_mode(freenect_resolution res,
+                                             freenect_depth_format fmt) {
+    freenect_frame_mode mode;
+    std::memset(&mode, 0, sizeof(mode));
+    mode.resolution = res;
+    mode.depth_format = fmt;
+    mode.is_valid = 1;
+
+    return mode;
+}
+
+int freenect_set_video_mode(freenect_device* dev,
+                            const freenect_frame_mode mode) {
+    return mode.is_valid ? 0 : -1;
+}
+
+int freenect_set_depth_mode(freenect_device* dev,
+                            const freenect_frame_mode mode) {
+    return mode.is_valid ? 0 : -1;
+}
+
+int freenect_set_video_buffer(freenect_device* dev, void* buf) {
+    dev->videoBuffer = buf;
+    return 0;
+}
+
+int freenect_set_depth_buffer(freenect_device* dev, void* buf) {
+    dev->depthBuffer = buf;
+    return 0;
+}
+
+int freenect_set_led(freenect_device* dev, freenect_led_options option) {
+    return 0;
+}
+
+int freenect_start_video(freenect_device* dev) {
+    std::lock_guard<std::mutex> lock(dev->context->mutex);
+    if (dev->videoStarted) {
+        return -1;
+    }
+
+    dev->videoStarted = true;
+    return 0;
+}
+
+int freenect_stop_video(freenect_device* dev) {
+    std::lock_guard<std::mutex> lock(dev->context->mutex);
+    if (!dev->videoStarted) {
+        return -1;
+    }
+
+    dev->videoStarted = false;
+    return 0;
+}
+
+int freenect_start_depth(freenect_device* dev) {
+    std::lock_guard<std::mutex> lock(dev->context->mutex);
+    if (dev->depthStarted) {
+        return -1;
+    }
+
+    dev->depthStarted = true;
+    return 0;
+}
+
+int freenect_stop_depth(freenect_device* dev) {
+    std::lock_guard<std::mutex> lock(dev->context->mutex);
+    if (!dev->depthStarted) {
+        return -1;
+    }
+
+    dev->depthStarted = false;
+    return 0;
+}
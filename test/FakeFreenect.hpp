@@ -0,0 +1,26 @@
+//=============================================================================
+//File Name: FakeFreenect.hpp
+//Description: Stands in for libfreenect so KinectCore can be tested without a
+//             Kinect
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * FakeFreenect.cpp defines every libfreenect function KinectCore uses, so the
+ * tests are linked with it instead of -lfreenect. It has one device, with
+ * serial number FAKE_FREENECT_SERIAL. While a stream is started, each call to
+ * freenect_process_events_timeout() delivers it an empty frame.
+ */
+
+#ifndef FAKE_FREENECT_HPP
+#define FAKE_FREENECT_HPP
+
+#define FAKE_FREENECT_SERIAL "FAKE0001"
+
+// Returns the number of devices opened and not yet closed
+int fakeFreenectOpenDevices();
+
+// Returns the number of contexts initialized and not yet shut down
+int fakeFreenectContexts();
+
+#endif // FAKE_FREENECT_HPP
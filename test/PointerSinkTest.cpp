@@ -0,0 +1,203 @@
+//=============================================================================
+//File Name: PointerSinkTest.cpp
+//Description: Checks which pointer events are coalesced away, and that the
+//             output stage hands MemorySink the rest in batches
+//Author: Tyler Veness
+//=============================================================================
+
+#include <chrono>
+#include <condition_variable>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Test.hpp"
+#include "../src/KinectCore.hpp"
+#include "../src/CKinect/MemorySink.hpp"
+
+// Longest to wait for the output stage to submit something
+#define POINTER_SINK_TEST_TIMEOUT std::chrono::seconds(5)
+
+static Contact makeContact(uint32_t id, int state, int x, int y) {
+    Contact contact;
+    contact.id = id;
+    contact.state = state;
+    contact.point = cvPoint(x, y);
+
+    return contact;
+}
+
+/* Builds an event with the given contacts. The mouse follows the first one
+ * that isn't going up, as it does in KinectCore::mapContacts().
+ */
+static PointerEvent makeEvent(std::initializer_list<Contact> contacts) {
+    PointerEvent event;
+
+    for (const auto& contact : contacts) {
+        event.contacts[event.contactCount++] = contact;
+
+        if (!event.pointer && contact.state != CONTACT_UP) {
+            event.x = contact.point.x;
+            event.y = contact.point.y;
+            event.pointer = true;
+        }
+    }
+
+    return event;
+}
+
+/* Holds up the first batch submitted to it until release() is called, so the
+ * events pushed meanwhile pile up in the output queue like they do behind a
+ * slow sink
+ */
+class GatedSink : public MemorySink {
+public:
+    int submit(const PointerEvent* events, unsigned int count) override {
+        {
+            std::unique_lock<std::mutex> lock(m_gateMutex);
+            if (!m_entered) {
+                m_entered = true;
+                m_gateCond.notify_all();
+                m_gateCond.wait(lock, [this] { return m_released; });
+            }
+        }
+
+        return MemorySink::submit(events, count);
+    }
+
+    // Waits for the first batch to arrive. Returns false on timeout.
+    bool waitForEntered() {
+        std::unique_lock<std::mutex> lock(m_gateMutex);
+        return m_gateCond.wait_for(lock, POINTER_SINK_TEST_TIMEOUT,
+                                   [this] { return m_entered; });
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(m_gateMutex);
+        m_released = true;
+        m_gateCond.notify_all();
+    }
+
+private:
+    std::mutex m_gateMutex;
+    std::condition_variable m_gateCond;
+    bool m_entered = false;
+    bool m_released = false;
+};
+
+class PointerSinkTest {
+public:
+    static void coalesce();
+    static void outputStage();
+};
+
+void PointerSinkTest::coalesce() {
+    std::vector<PointerEvent> batch;
+
+    // A move followed by a newer position of the same pointer is dropped
+    batch = {makeEvent({makeContact(1, CONTACT_MOVE, 10, 10)}),
+             makeEvent({makeContact(1, CONTACT_MOVE, 20, 20)}),
+             makeEvent({makeContact(1, CONTACT_MOVE, 30, 30)})};
+    coalescePointerEvents(batch, nullptr);
+    TEST_CHECK(batch.size() == 1);
+    TEST_CHECK(batch.size() == 1 && batch[0].x == 30);
+
+    // Presses and releases are kept even when a newer event follows them
+    batch = {makeEvent({makeContact(1, CONTACT_DOWN, 10, 10)}),
+             makeEvent({makeContact(1, CONTACT_MOVE, 20, 20)}),
+             makeEvent({makeContact(1, CONTACT_MOVE, 30, 30)}),
+             makeEvent({makeContact(1, CONTACT_UP, 30, 30)})};
+    coalescePointerEvents(batch, nullptr);
+    TEST_CHECK(batch.size() == 3);
+    if (batch.size() == 3) {
+        TEST_CHECK(batch[0].contacts[0].state == CONTACT_DOWN);
+        TEST_CHECK(batch[1].contacts[0].state == CONTACT_MOVE);
+        TEST_CHECK(batch[1].x == 30);
+        TEST_CHECK(batch[2].contacts[0].state == CONTACT_UP);
+    }
+
+    // A move isn't superseded by an event that leaves one of its pointers out
+    batch = {makeEvent({makeContact(1, CONTACT_MOVE, 10, 10),
+                        makeContact(2, CONTACT_MOVE, 50, 50)}),
+             makeEvent({makeContact(1, CONTACT_MOVE, 20, 20)})};
+    coalescePointerEvents(batch, nullptr);
+    TEST_CHECK(batch.size() == 2);
+
+    // Nor by an event that doesn't move the mouse
+    batch = {makeEvent({makeContact(1, CONTACT_MOVE, 10, 10)}),
+             makeEvent({makeContact(1, CONTACT_UP, 10, 10)})};
+    coalescePointerEvents(batch, nullptr);
+    TEST_CHECK(batch.size() == 2);
+
+    // A move that changes nothing since the last event submitted is dropped
+    PointerEvent last = makeEvent({makeContact(1, CONTACT_MOVE, 10, 10)});
+    batch = {makeEvent({makeContact(1, CONTACT_MOVE, 10, 10)})};
+    coalescePointerEvents(batch, &last);
+    TEST_CHECK(batch.empty());
+
+    batch = {makeEvent({makeContact(1, CONTACT_MOVE, 11, 10)})};
+    coalescePointerEvents(batch, &last);
+    TEST_CHECK(batch.size() == 1);
+}
+
+void PointerSinkTest::outputStage() {
+    KinectCore kinect;
+
+    auto sink = std::make_shared<GatedSink>();
+    kinect.setPointerSink(sink);
+
+    unsigned int coalesced = kinect.getPipelineStats().coalesced;
+
+    // The first event is submitted alone, and the sink holds on to it
+    kinect.m_outputQueue.push(
+        makeEvent({makeContact(1, CONTACT_MOVE, 10, 10)}));
+    TEST_CHECK(sink->waitForEntered());
+
+    // These queue up behind it and reach the sink as one batch
+    kinect.m_outputQueue.push(
+        makeEvent({makeContact(1, CONTACT_MOVE, 20, 20)}));
+    kinect.m_outputQueue.push(
+        makeEvent({makeContact(1, CONTACT_MOVE, 30, 30),
+                   makeContact(2, CONTACT_DOWN, 50, 50)}));
+    kinect.m_outputQueue.push(
+        makeEvent({makeContact(1, CONTACT_MOVE, 40, 40),
+                   makeContact(2, CONTACT_MOVE, 60, 60)}));
+    kinect.m_outputQueue.push(
+        makeEvent({makeContact(1, CONTACT_MOVE, 50, 50),
+                   makeContact(2, CONTACT_MOVE, 70, 70)}));
+    kinect.m_outputQueue.push(
+        makeEvent({makeContact(1, CONTACT_MOVE, 60, 60),
+                   makeContact(2, CONTACT_UP, 70, 70)}));
+
+    sink->release();
+    TEST_CHECK(sink->waitFor(3, POINTER_SINK_TEST_TIMEOUT));
+
+    kinect.shutdown();
+
+    std::vector<unsigned int> batchSizes = sink->batchSizes();
+    TEST_CHECK(batchSizes.size() == 2);
+    if (batchSizes.size() == 2) {
+        TEST_CHECK(batchSizes[0] == 1);
+        TEST_CHECK(batchSizes[1] == 2);
+    }
+
+    // Only the first event, the press and the release get through
+    std::vector<PointerEvent> events = sink->events();
+    TEST_CHECK(events.size() == 3);
+    if (events.size() == 3) {
+        TEST_CHECK(events[0].x == 10);
+        TEST_CHECK(events[1].contactCount == 2 &&
+                   events[1].contacts[1].state == CONTACT_DOWN);
+        TEST_CHECK(events[2].contactCount == 2 &&
+                   events[2].contacts[1].state == CONTACT_UP);
+        TEST_CHECK(events[2].x == 60);
+    }
+
+    TEST_CHECK(kinect.getPipelineStats().coalesced - coalesced == 3);
+}
+
+void pointerSinkTest() {
+    PointerSinkTest::coalesce();
+    PointerSinkTest::outputStage();
+}
@@ -0,0 +1,61 @@
+//=============================================================================
+//File Name: Test.cpp
+//Description: Runs the tests and reports which of them failed
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * Usage: KinectBoardTest [filter]
+ * Only tests whose names contain filter are run. Exits with a nonzero status
+ * if any test failed.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "Test.hpp"
+
+static unsigned int gFailures = 0;
+
+bool testCheck(bool passed, const char* expression, const char* file,
+               int line) {
+    if (!passed) {
+        std::printf("%s:%d: check failed: %s\n", file, line, expression);
+        gFailures++;
+    }
+
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    struct {
+        const char* name;
+        void (*func)();
+    } tests[] = {
+        {"allocation", allocationTest},
+        {"capture", captureTest},
+        {"pointerSink", pointerSinkTest}
+    };
+
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    unsigned int failed = 0;
+
+    for (const auto& test : tests) {
+        if (filter != nullptr && std::strstr(test.name, filter) == nullptr) {
+            continue;
+        }
+
+        unsigned int failures = gFailures;
+        test.func();
+
+        if (gFailures == failures) {
+            std::printf("%s: passed\n", test.name);
+        }
+        else {
+            std::printf("%s: FAILED\n", test.name);
+            failed++;
+        }
+    }
+
+    return failed == 0 ? 0 : 1;
+}
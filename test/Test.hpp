@@ -0,0 +1,27 @@
+//=============================================================================
+//File Name: Test.hpp
+//Description: Checks shared by the tests
+//Author: Tyler Veness
+//=============================================================================
+
+/*
+ * Each test is a function that makes its checks with TEST_CHECK(). A failed
+ * check prints where it failed and marks the test failed, but the test keeps
+ * running so every failure is reported.
+ */
+
+#ifndef TEST_HPP
+#define TEST_HPP
+
+#define TEST_CHECK(condition) \
+    testCheck((condition), #condition, __FILE__, __LINE__)
+
+// Records a failure if passed is false. Returns passed.
+bool testCheck(bool passed, const char* expression, const char* file,
+               int line);
+
+void allocationTest();
+void captureTest();
+void pointerSinkTest();
+
+#endif // TEST_HPP